@@ -0,0 +1,48 @@
+/*
+ *  Beacon rate control, see beaconRate.h.
+ */
+
+#include "beaconRate.h"
+
+void BeaconRate::reset() {
+  intervalMs = BEACON_MIN_MS;
+  burst = BEACON_BURST;
+}
+
+bool BeaconRate::timeAdjusted(int32_t offsetUs, uint32_t nowMs) {
+  uint32_t offset = offsetUs < 0 ? -(int64_t)offsetUs : offsetUs;
+  uint32_t elapsedMs = nowMs - lastAdjustMs;
+
+  // the first adjustment after boot is the clock being set, not drift
+  if (lastAdjustMs != 0 && elapsedMs > 0) driftPpm = (uint64_t)offset * 1000 / elapsedMs;
+  lastAdjustMs = nowMs;
+
+  if (offset <= BEACON_RESYNC_US) return false;
+
+  intervalMs = BEACON_MIN_MS;
+  return true;
+}
+
+uint32_t BeaconRate::next(uint32_t nodes) {
+  uint32_t interval;
+
+  if (burst > 0) {
+    burst--;
+    interval = BEACON_MIN_MS;
+  }
+  else {
+    intervalMs = intervalMs * 2 > BEACON_MAX_MS ? BEACON_MAX_MS : intervalMs * 2;
+    interval = intervalMs;
+
+    if (driftPpm > 0) {
+      uint64_t driftLimit = (uint64_t)BEACON_DRIFT_BUDGET_US * 1000 / driftPpm;
+      if (driftLimit < interval) interval = driftLimit;
+    }
+  }
+
+  uint32_t airtimeLimit = (uint64_t)BEACON_AIR_BYTES * nodes * 1000 / BEACON_AIRTIME_BUDGET;
+  if (interval < airtimeLimit) interval = airtimeLimit;
+  if (interval < BEACON_MIN_MS) interval = BEACON_MIN_MS;
+
+  return interval;
+}
@@ -0,0 +1,46 @@
+/*
+ *  Beacon rate control for the controller.
+ *
+ *  A fixed beacon period is too slow for a node that just joined and wasteful for a big mesh that hasn't changed in an
+ *  hour.  BeaconRate picks the time to the next beacon:
+ *
+ *    - after a topology change, BEACON_BURST beacons BEACON_MIN_MS apart, so new nodes lock on at once
+ *    - then the interval doubles with every beacon, up to BEACON_MAX_MS
+ *    - but no longer than it takes the measured clock drift to add up to BEACON_DRIFT_BUDGET_US.  Receivers don't
+ *      report anything back, so the drift is the controller's own: how far painlessMesh's time sync moves its mesh
+ *      clock, per second since the previous adjustment, less what drift.h already corrects for.  A large adjustment
+ *      also restarts the backoff.
+ *    - and never so often that a flood of beacons over the whole mesh (one copy per node) goes over
+ *      BEACON_AIRTIME_BUDGET bytes per second
+ */
+
+#ifndef BEACONRATE_H
+#define BEACONRATE_H
+
+#include <stdint.h>
+
+#define BEACON_MIN_MS            250      // num milliseconds between beacons in a burst
+#define BEACON_MAX_MS            8000     // num milliseconds between beacons once the mesh has settled
+#define BEACON_BURST             4        // num fast beacons after a topology change
+#define BEACON_DRIFT_BUDGET_US   3000     // num microseconds of drift allowed to build up between beacons (a quarter of a hue step)
+#define BEACON_RESYNC_US         1000     // a time adjustment bigger than this restarts the backoff
+#define BEACON_AIRTIME_BUDGET    8000     // bytes per second of beacons, summed over every node in the mesh
+#define BEACON_AIR_BYTES         80       // one beacon as painlessMesh sends it (see bench_codec)
+
+class BeaconRate {
+public:
+  BeaconRate() : driftPpm(0), lastAdjustMs(0) { reset(); }
+
+  void reset();                                         // as after a topology change
+  void topologyChanged() { reset(); }
+  bool timeAdjusted(int32_t offsetUs, uint32_t nowMs);  // true if the backoff restarted
+
+  uint32_t next(uint32_t nodes);                        // ms until the beacon after the one being sent now
+
+  uint32_t intervalMs;                                  // backoff, before the drift and airtime limits
+  uint8_t burst;                                        // fast beacons still to send
+  uint32_t driftPpm;                                    // from the last time adjustment
+  uint32_t lastAdjustMs;
+};
+
+#endif
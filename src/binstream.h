@@ -0,0 +1,108 @@
+/*
+ *  Little-endian readers and writers for the binary formats (mesh traces, frame captures, ...).
+ *
+ *  Fixed-width integers are little-endian.  Varints are LEB128: seven bits per byte, low bits first, high bit set on
+ *  every byte but the last.  Signed varints are zigzag-encoded first, so small negative numbers stay small.
+ *
+ *  Neither class allocates.  Running off the end of the buffer sets a flag instead of writing (or reading) past it;
+ *  check it once at the end.
+ */
+
+#ifndef BINSTREAM_H
+#define BINSTREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+class BinWriter {
+public:
+  BinWriter(uint8_t *buffer, size_t capacity) : buffer(buffer), capacity(capacity), length(0), overflow(false) {}
+
+  void put8(uint8_t v) {
+    if (length < capacity) buffer[length++] = v;
+    else overflow = true;
+  }
+
+  void put16(uint16_t v) { put8(v); put8(v >> 8); }
+  void put32(uint32_t v) { put16(v); put16(v >> 16); }
+  void put64(uint64_t v) { put32(v); put32(v >> 32); }
+
+  void putVarint(uint64_t v) {
+    while (v >= 0x80) {
+      put8((v & 0x7F) | 0x80);
+      v >>= 7;
+    }
+    put8(v);
+  }
+
+  void putSigned(int64_t v) { putVarint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63)); }
+
+  void putBytes(const void *data, size_t count) {
+    if (count > capacity - length) {
+      overflow = true;
+      return;
+    }
+    memcpy(buffer + length, data, count);
+    length += count;
+  }
+
+  uint8_t *buffer;
+  size_t capacity;
+  size_t length;
+  bool overflow;
+};
+
+class BinReader {
+public:
+  BinReader(const uint8_t *buffer, size_t length) : buffer(buffer), length(length), position(0), overflow(false) {}
+
+  uint8_t get8() {
+    if (position < length) return buffer[position++];
+    overflow = true;
+    return 0;
+  }
+
+  uint16_t get16() { uint16_t v = get8(); return v | (uint16_t)get8() << 8; }
+  uint32_t get32() { uint32_t v = get16(); return v | (uint32_t)get16() << 16; }
+  uint64_t get64() { uint64_t v = get32(); return v | (uint64_t)get32() << 32; }
+
+  uint64_t getVarint() {
+    uint64_t v = 0;
+
+    for (uint8_t shift = 0; shift < 64; shift += 7) {
+      uint8_t b = get8();
+      v |= (uint64_t)(b & 0x7F) << shift;
+      if (!(b & 0x80)) return v;
+    }
+
+    overflow = true;                  // more than ten bytes: not a varint
+    return v;
+  }
+
+  int64_t getSigned() {
+    uint64_t v = getVarint();
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+  }
+
+  // points into the buffer rather than copying; nullptr if there aren't that many bytes left
+  const uint8_t *getBytes(size_t count) {
+    if (count > length - position) {
+      overflow = true;
+      position = length;
+      return nullptr;
+    }
+    const uint8_t *at = buffer + position;
+    position += count;
+    return at;
+  }
+
+  bool atEnd() const { return position >= length; }
+
+  const uint8_t *buffer;
+  size_t length;
+  size_t position;
+  bool overflow;
+};
+
+#endif
@@ -0,0 +1,41 @@
+/*
+ *  Commands scheduled for a mesh time, see commands.h.
+ */
+
+#include <string.h>
+#include "commands.h"
+
+void CommandQueue::clear() {
+  count = 0;
+  memset(entries, 0, sizeof(entries));
+}
+
+bool CommandQueue::push(const Command &command) {
+  uint8_t at = count;
+
+  // find its place from the back, a few entries at most
+  while (at > 0 && entries[at - 1].at > command.at) at--;
+
+  for (uint8_t i = at; i > 0 && entries[i - 1].at == command.at; i--) {
+    if (entries[i - 1].type == command.type && entries[i - 1].argument == command.argument) return false;
+  }
+
+  if (count == COMMAND_SLOTS) {
+    if (at == COMMAND_SLOTS) return false;
+    count--;                              // the last one falls off the end
+  }
+
+  memmove(&entries[at + 1], &entries[at], (count - at) * sizeof(Command));
+  entries[at] = command;
+  count++;
+  return true;
+}
+
+bool CommandQueue::pop(uint64_t now, Command &command) {
+  if (count == 0 || entries[0].at > now) return false;
+
+  command = entries[0];
+  count--;
+  memmove(&entries[0], &entries[1], count * sizeof(Command));
+  return true;
+}
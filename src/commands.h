@@ -0,0 +1,47 @@
+/*
+ *  Commands scheduled for a mesh time.
+ *
+ *  A mode change in a beacon takes effect wherever the beacon has got to, so a change ripples out across the mesh hop
+ *  by hop.  A command instead says what to do and when: the controller broadcasts it (MSG_COMMAND) COMMAND_LEAD_MS
+ *  ahead, every node (the controller too) queues it here, and updateMesh() runs it on the first frame at or after
+ *  that mesh time.  Every node that got it in time switches on the same frame, give or take how well painlessMesh has
+ *  synced the clocks.  One that gets it too late runs it on its next frame.  The controller broadcasts COMMAND_COPIES
+ *  copies, so one lost copy doesn't leave a node behind, and when it runs a mode change itself it starts a burst of
+ *  beacons, which carry the new mode to any node that missed every copy.
+ *
+ *  The queue is COMMAND_SLOTS fixed entries kept in time order.  When it's full, the command furthest in the future
+ *  is the one that loses its place.  A copy of a command already queued (same time, same command) is ignored.
+ */
+
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <stdint.h>
+
+#define COMMAND_SLOTS     8
+#define COMMAND_LEAD_MS   500             // how far ahead the controller schedules a command: more than any trip across the mesh should take
+#define COMMAND_COPIES    3               // how many times the controller broadcasts it
+
+enum CommandType {
+  COMMAND_DISPLAY_MODE = 1,               // argument: the mode
+};
+
+struct Command {
+  uint64_t at;                            // mesh time to run it at, microseconds
+  uint8_t type;
+  uint8_t argument;
+};
+
+class CommandQueue {
+public:
+  CommandQueue() { clear(); }
+  void clear();
+
+  bool push(const Command &command);      // false if it's a copy, or later than everything in a full queue
+  bool pop(uint64_t now, Command &command);   // the earliest command, if it's due by now
+
+  uint8_t count;
+  Command entries[COMMAND_SLOTS];         // earliest first
+};
+
+#endif
@@ -0,0 +1,50 @@
+/*
+ *  Duplicate suppression for broadcasts, see dedupe.h.
+ */
+
+#include <string.h>
+#include "dedupe.h"
+
+DedupeResult DedupeCache::check(uint32_t from, uint16_t seq, uint32_t timestamp) {
+  clock++;
+
+  Sender *slot = &senders[0];
+  for (Sender &sender : senders) {
+    if (sender.nodeId == from) {
+      slot = &sender;
+      break;
+    }
+    if (sender.nodeId == 0 || (int32_t)(sender.lastHeard - slot->lastHeard) < 0) slot = &sender;
+  }
+
+  if (slot->nodeId == from) {
+    slot->lastHeard = clock;
+
+    if ((int16_t)(seq - slot->lastSeq) <= 0) {
+      if (seq == slot->lastSeq && timestamp == slot->lastTimestamp) {
+        counters.duplicates++;
+        return DEDUPE_DUPLICATE;
+      }
+      if ((int32_t)(timestamp - slot->lastTimestamp) <= 0) {
+        counters.stale++;
+        return DEDUPE_STALE;
+      }
+      counters.restarts++;
+    }
+  }
+  else {
+    slot->nodeId = from;              // new sender, or one that was evicted: take whatever it sends
+    slot->lastHeard = clock;
+  }
+
+  slot->lastSeq = seq;
+  slot->lastTimestamp = timestamp;
+  counters.accepted++;
+  return DEDUPE_NEW;
+}
+
+void DedupeCache::clear() {
+  memset(senders, 0, sizeof(senders));
+  memset(&counters, 0, sizeof(counters));
+  clock = 0;
+}
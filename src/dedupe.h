@@ -0,0 +1,55 @@
+/*
+ *  Duplicate suppression for broadcasts.
+ *
+ *  painlessMesh floods broadcasts, so on a dense mesh the same message can reach a node more than once, and a later
+ *  copy can overtake an earlier message.  DedupeCache remembers the last sequence number and timestamp heard from each
+ *  of the DEDUPE_SENDERS most recently heard senders (fixed slots, least recently heard one is reused) and says
+ *  whether a message is new, a copy of one already handled, or older than one already handled.
+ *
+ *  A sender that restarts counts from sequence number 0 again.  Its mesh time doesn't restart, so a message whose
+ *  sequence number looks old but whose timestamp is newer than anything heard from that sender is taken as a restart
+ *  and accepted.  Sequence numbers and timestamps are compared as wrapping counters.
+ */
+
+#ifndef DEDUPE_H
+#define DEDUPE_H
+
+#include <stdint.h>
+
+#define DEDUPE_SENDERS 16                 // senders remembered at once; a mesh rarely has more than one or two talking
+
+enum DedupeResult {
+  DEDUPE_NEW,
+  DEDUPE_DUPLICATE,                       // same sequence number as the last one from that sender
+  DEDUPE_STALE                            // older than the last one from that sender
+};
+
+struct DedupeCounters {
+  uint32_t accepted;
+  uint32_t duplicates;
+  uint32_t stale;
+  uint32_t restarts;                      // accepted on the timestamp after the sequence number went backwards
+};
+
+class DedupeCache {
+public:
+  DedupeCache() { clear(); }
+
+  DedupeResult check(uint32_t from, uint16_t seq, uint32_t timestamp);
+  void clear();                           // forget every sender, and zero the counters
+
+  DedupeCounters counters;
+
+private:
+  struct Sender {
+    uint32_t nodeId;                      // 0 for a free slot
+    uint16_t lastSeq;
+    uint32_t lastTimestamp;
+    uint32_t lastHeard;                   // value of clock when it was last checked, for eviction
+  };
+
+  Sender senders[DEDUPE_SENDERS];
+  uint32_t clock;
+};
+
+#endif
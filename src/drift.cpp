@@ -0,0 +1,76 @@
+/*
+ *  Clock drift estimation, see drift.h.
+ */
+
+#include <string.h>
+#include "drift.h"
+
+void DriftEstimator::reset() {
+  ppb = 0;
+  count = 0;
+  next = 0;
+  lastAdjustMs = 0;
+  takenUs = 0;
+  started = false;
+  memset(samples, 0, sizeof(samples));
+}
+
+int32_t DriftEstimator::adjusted(int32_t offsetUs, uint32_t nowMs) {
+  int64_t residual = offsetUs - correction(nowMs);
+  int64_t total = count > 0 ? samples[(next + DRIFT_WINDOW - 1) % DRIFT_WINDOW].totalUs + offsetUs : 0;
+
+  lastAdjustMs = nowMs;
+  takenUs = 0;
+
+  if (!started || residual >= DRIFT_STEP_US || residual <= -DRIFT_STEP_US) {
+    started = true;
+    ppb = 0;
+    count = 0;
+    next = 0;
+    total = 0;
+  }
+
+  samples[next].atMs = nowMs;
+  samples[next].totalUs = total;
+  next = (next + 1) % DRIFT_WINDOW;
+  if (count < DRIFT_WINDOW) count++;
+
+  // least squares over the window, against time since its oldest sample.  Once a minute or so, so doubles are fine.
+  if (count >= 2) {
+    uint32_t oldest = samples[(next + DRIFT_WINDOW - count) % DRIFT_WINDOW].atMs;
+    double meanT = 0, meanC = 0;
+
+    for (uint8_t i = 0; i < count; i++) {
+      meanT += (double)(samples[i].atMs - oldest);
+      meanC += (double)samples[i].totalUs;
+    }
+    meanT /= count;
+    meanC /= count;
+
+    double covariance = 0, variance = 0;
+    for (uint8_t i = 0; i < count; i++) {
+      double t = (double)(samples[i].atMs - oldest) - meanT;
+      covariance += t * ((double)samples[i].totalUs - meanC);
+      variance += t * t;
+    }
+
+    if (variance > 0) {
+      double rate = covariance / variance * 1e6;          // microseconds per millisecond, to parts per billion
+      double limit = DRIFT_MAX_PPM * 1000.0;
+      ppb = rate > limit ? limit : rate < -limit ? -limit : rate;
+    }
+  }
+
+  return residual > INT32_MAX ? INT32_MAX : residual < INT32_MIN ? INT32_MIN : residual;
+}
+
+int64_t DriftEstimator::correction(uint32_t nowMs) const {
+  if (!started) return 0;
+  return (int64_t)ppb * (uint32_t)(nowMs - lastAdjustMs) / 1000000;
+}
+
+int32_t DriftEstimator::takeMicros(uint32_t nowMs) {
+  int32_t us = correction(nowMs) - takenUs;
+  takenUs += us;
+  return us;
+}
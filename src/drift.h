@@ -0,0 +1,49 @@
+/*
+ *  Clock drift estimation and skew compensation.
+ *
+ *  painlessMesh keeps a node's mesh time in step by jumping it every so often, by however far the node's oscillator
+ *  has wandered since the last time.  On a long strip a jump of a few milliseconds is a visible step in the rainbow.
+ *  DriftEstimator keeps the last DRIFT_WINDOW adjustments as (local time, total of every offset so far) and fits a
+ *  line through them by least squares: the slope is how fast this node's clock runs against mesh time.  Between
+ *  adjustments correction() is that rate times the time since the last one, so mesh time plus the correction moves
+ *  smoothly, and the next adjustment only has the residual (what the fit didn't predict) left to jump.
+ *
+ *  The first adjustment after boot is the clock being set, not drift, and so is one that's DRIFT_STEP_US or more off
+ *  the prediction (meshes merging, say): either one starts the fit over.
+ */
+
+#ifndef DRIFT_H
+#define DRIFT_H
+
+#include <stdint.h>
+
+#define DRIFT_WINDOW     8                // adjustments the fit is over
+#define DRIFT_STEP_US    50000            // an adjustment this far off the prediction is a step, not drift
+#define DRIFT_MAX_PPM    500              // rates beyond this are taken to be a bad fit, and clamped
+
+struct DriftSample {
+  uint32_t atMs;                          // local millis() of the adjustment
+  int64_t totalUs;                        // all the offsets up to and including it, since the fit started
+};
+
+class DriftEstimator {
+public:
+  DriftEstimator() { reset(); }
+  void reset();
+
+  // painlessMesh moved mesh time by offsetUs.  Returns the residual: the part of it correction() hadn't predicted.
+  int32_t adjusted(int32_t offsetUs, uint32_t nowMs);
+
+  int64_t correction(uint32_t nowMs) const;   // microseconds to add to mesh time, by now
+  int32_t takeMicros(uint32_t nowMs);         // correction since the last call, for the hue phase
+
+  int32_t ppb;                            // fitted rate of mesh time against this clock, parts per billion; 0 until there's a fit
+  uint8_t count;
+  uint8_t next;                           // ring index of the slot the next sample goes in
+  DriftSample samples[DRIFT_WINDOW];
+  uint32_t lastAdjustMs;
+  int64_t takenUs;                        // what takeMicros() has handed out since the last adjustment
+  bool started;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "frameCapture.h"
+#include "binstream.h"
+#include "meshLights.h"                   // meshTime()
+
+void CaptureLedSink::begin(TraceOutput *output, uint32_t nodeId, uint16_t count) {
+  uint8_t header[11];
+  BinWriter w(header, sizeof(header));
+
+  w.putBytes("MLFC", 4);
+  w.put8(CAPTURE_VERSION);
+  w.put32(nodeId);
+  w.put16(count);
+
+  this->output = output;
+  frames = 0;
+  bytes = 0;
+  lastMeshTime = 0;
+  write(header, w.length);
+}
+
+void CaptureLedSink::end() {
+  if (output) output->flush();
+  output = nullptr;
+}
+
+void CaptureLedSink::write(const uint8_t *data, size_t length) {
+  if (!output) return;
+
+  if (bytes + length > maxBytes) {
+    Serial.printf("!! CAPTURE: reached %u bytes after %u frames, capture stopped\n", bytes, frames);
+    end();
+    return;
+  }
+
+  output->write(data, length);
+  bytes += length;
+}
+
+void CaptureLedSink::show(const CRGB *pixels, uint16_t count) {
+  if (output) {
+    uint64_t now = meshTime();
+    bool withPixels = frames % CAPTURE_PIXELS_EVERY == 0;
+    uint8_t head[11];
+    BinWriter w(head, sizeof(head));
+
+    w.put8(withPixels ? CAPTURE_HAS_PIXELS : 0);
+    w.putSigned((int64_t)(now - lastMeshTime));
+    write(head, w.length);
+
+    // CRGB is three bytes, r, g, b, so the pixels can go out as they are
+    if (withPixels) write((const uint8_t *)pixels, (size_t)count * 3);
+
+    lastMeshTime = now;
+    frames++;
+    if (output && frames % CAPTURE_FLUSH_FRAMES == 0) output->flush();
+  }
+
+  if (next) next->show(pixels, count);
+}
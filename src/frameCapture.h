@@ -0,0 +1,60 @@
+/*
+ *  Frame capture.
+ *
+ *  CaptureLedSink sits in front of another LedSink (or none) and appends every frame it's shown to a binary stream:
+ *  the mesh time of the show() and, for every CAPTURE_PIXELS_EVERY-th frame, the pixels themselves.  Point ledSink at
+ *  one to capture at runtime; on the ESP32, -D CAPTURE_FRAMES does that from setup() (see [env:esp32dev_capture]).
+ *  The framediff tool (src/host/framediff) reads the streams back for frame rate, jitter, sync offsets between nodes
+ *  and golden-image comparisons.
+ *
+ *  Format (see binstream.h for the encodings):
+ *
+ *    header:  "MLFC", u8 version, u32 node ID, u16 pixels per frame
+ *    frame:   u8 flags (bit 0: pixels follow), signed varint mesh microseconds since the previous frame (since 0 for
+ *             the first), then r, g, b x pixels per frame if flagged
+ *
+ *  The mesh time is meshTime(): 64 bits, so it doesn't wrap, and drift-corrected.  painlessMesh's time adjustments
+ *  can still step it back, which is a negative interval.
+ */
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include "hal.h"
+#include "traceRecorder.h"                // TraceOutput
+
+#define CAPTURE_VERSION     2
+#define CAPTURE_HAS_PIXELS  0x01
+
+#ifndef CAPTURE_PIXELS_EVERY
+#define CAPTURE_PIXELS_EVERY 1            // keep the pixels of every Nth frame (the timing of every frame is kept)
+#endif
+
+#define CAPTURE_FLUSH_FRAMES 256         // num frames between flushes of the output
+
+#define CAPTURE_MAX_BYTES   1048576       // default for maxBytes, sized for ESP32 flash
+
+class CaptureLedSink : public LedSink {
+public:
+  CaptureLedSink(LedSink *next = nullptr) :
+    next(next), output(nullptr), maxBytes(CAPTURE_MAX_BYTES), frames(0), bytes(0), lastMeshTime(0) {}
+
+  void begin(TraceOutput *output, uint32_t nodeId, uint16_t count);
+  void end();
+
+  void setBrightness(uint8_t scale) { if (next) next->setBrightness(scale); }
+  void show(const CRGB *pixels, uint16_t count);
+
+  LedSink *next;                          // where frames go after they've been captured
+  TraceOutput *output;
+  uint32_t maxBytes;                      // capture stops once the stream gets this big
+  uint32_t frames;
+  uint32_t bytes;
+
+private:
+  void write(const uint8_t *data, size_t length);
+
+  uint64_t lastMeshTime;
+};
+
+#endif
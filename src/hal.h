@@ -0,0 +1,66 @@
+/*
+ *  Hardware abstraction layer.
+ *
+ *  The display and mesh logic never touches FastLED.show(), painlessMesh or WiFi directly; it goes through the three
+ *  pointers below.  main.cpp points them at the real hardware, the host builds in src/host point them at whatever they
+ *  need for a benchmark or a simulation (null sinks, virtual clocks, in-memory mesh transports, ...).
+ */
+
+#ifndef HAL_H
+#define HAL_H
+
+#include <Arduino.h>
+#include <FastLED.h>
+
+#ifdef ARDUINO
+#include <painlessMesh.h>              // provides SimpleList
+#else
+#include <list>
+template <typename T> using SimpleList = std::list<T>;    // same definition painlessMesh uses
+#endif
+
+// where a finished frame goes.  On the ESP32 this is FastLED driving the strip.
+class LedSink {
+public:
+  virtual ~LedSink() {}
+  virtual void setBrightness(uint8_t scale) = 0;
+  virtual void show(const CRGB *pixels, uint16_t count) = 0;
+};
+
+// the parts of painlessMesh (and WiFi) that the logic uses
+class MeshTransport {
+public:
+  virtual ~MeshTransport() {}
+  virtual void update() = 0;
+  virtual uint32_t getNodeId() = 0;
+  virtual uint32_t getNodeTime() = 0;                    // mesh-synchronized time, in microseconds.  Wraps every 71 minutes, see meshTime().
+  virtual SimpleList<uint32_t> getNodeList() = 0;        // every other node in the mesh, not including this one
+  virtual bool sendBroadcast(String &msg) = 0;
+  virtual bool sendSingle(uint32_t dest, String &msg) = 0;
+  virtual String subConnectionJson() = 0;
+  virtual uint8_t hopsTo(uint32_t nodeId) { return 0; }  // how many links away a node is, 0 if it's not known.  Can be slow: ask when the topology changes
+
+  // radio link details, only used for diagnostics and FADE_BY_DISTANCE
+  virtual int32_t rssi() = 0;
+  virtual String localIP() = 0;
+  virtual const char* linkMode() = 0;
+  virtual const char* linkStatus() = 0;
+};
+
+// this node's own (unsynchronized) clock
+class Clock {
+public:
+  virtual ~Clock() {}
+  virtual uint32_t millis() = 0;
+  virtual uint32_t micros() = 0;
+
+  // the finest-grained counter available, for the profiler.  Falls back to microseconds.
+  virtual uint32_t cycles() { return micros(); }
+  virtual uint32_t cyclesPerMicro() { return 1; }
+};
+
+extern LedSink *ledSink;
+extern MeshTransport *meshTransport;
+extern Clock *localClock;
+
+#endif
@@ -0,0 +1,159 @@
+#include "meshLights.h"
+#include "heapTracker.h"
+
+#include <stddef.h>
+
+#ifdef ARDUINO
+#include <esp_heap_caps.h>
+#endif
+
+HeapCounters heapCounters;
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// ALLOCATOR HOOKS
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined(HEAP_HOOKS) && defined(ARDUINO)
+
+// linked with -Wl,--wrap=malloc,... so every call lands here first and __real_* is the allocator
+static volatile TaskHandle_t trackedTask = NULL;
+
+static inline bool counting() {
+  return trackedTask != NULL && xTaskGetCurrentTaskHandle() == trackedTask;
+}
+
+extern "C" {
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size) {
+  if (counting()) { heapCounters.allocs++; heapCounters.bytes += size; }
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size) {
+  if (counting()) { heapCounters.allocs++; heapCounters.bytes += count * size; }
+  return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  if (counting()) { heapCounters.allocs++; heapCounters.bytes += size; }
+  return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+  if (ptr && counting()) heapCounters.frees++;
+  __real_free(ptr);
+}
+
+}
+
+#elif defined(HEAP_HOOKS)
+
+// glibc: replace the C library's entry points and hand off to its internal ones.  operator new and the String
+// stand-in both land here, so the counts cover everything the logic allocates.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void __libc_free(void *ptr);
+
+void *malloc(size_t size) {
+  heapCounters.allocs++;
+  heapCounters.bytes += size;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) {
+  heapCounters.allocs++;
+  heapCounters.bytes += count * size;
+  return __libc_calloc(count, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  heapCounters.allocs++;
+  heapCounters.bytes += size;
+  return __libc_realloc(ptr, size);
+}
+
+void free(void *ptr) {
+  if (ptr) heapCounters.frees++;
+  __libc_free(ptr);
+}
+
+}
+
+#endif
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// SCOPES AND REPORTING
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+#ifdef TRACK_HEAP
+
+struct ScopeStats {
+  uint32_t calls;
+  uint32_t allocatingCalls;           // calls that allocated at all
+  uint64_t allocs;
+  uint64_t bytes;
+  uint32_t maxAllocs;                 // high-water marks for a single call
+  uint32_t maxBytes;
+};
+
+static const char *scopeNames[NUM_HEAP_SCOPES] = { "loop", "received", "changedConn", "timeAdjusted" };
+
+static ScopeStats scopes[NUM_HEAP_SCOPES];
+static CEveryNSeconds heapReportTimer(HEAP_REPORT_SECONDS);
+
+HeapScope::~HeapScope() {
+  ScopeStats &s = scopes[id];
+  uint32_t allocs = heapCounters.allocs - start.allocs;
+  uint32_t bytes = heapCounters.bytes - start.bytes;
+
+  s.calls++;
+  if (allocs == 0) return;
+
+  s.allocatingCalls++;
+  s.allocs += allocs;
+  s.bytes += bytes;
+  if (allocs > s.maxAllocs) s.maxAllocs = allocs;
+  if (bytes > s.maxBytes) s.maxBytes = bytes;
+}
+
+void heapTrackerBegin() {
+#ifdef ARDUINO
+  trackedTask = xTaskGetCurrentTaskHandle();
+#endif
+}
+
+void heapTrackerReportIfDue() {
+  if (!heapReportTimer) return;
+
+  Serial.printf("\n>> HEAP: last %d s\n", HEAP_REPORT_SECONDS);
+  Serial.printf("   %-12s %8s %10s %10s %10s %10s %10s\n", "scope", "calls", "allocating", "allocs/call", "bytes/call", "max allocs", "max bytes");
+
+  for (uint8_t i = 0; i < NUM_HEAP_SCOPES; i++) {
+    const ScopeStats &s = scopes[i];
+    if (s.calls == 0) continue;
+
+    Serial.printf("   %-12s %8u %10u %10.2f %10.1f %10u %10u\n", scopeNames[i], s.calls, s.allocatingCalls,
+      (double)s.allocs / s.calls, (double)s.bytes / s.calls, s.maxAllocs, s.maxBytes);
+  }
+
+#ifdef ARDUINO
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+
+  // fragmentation: how much of the free heap can't be had in one piece
+  Serial.printf("   free %u, low-water %u, largest block %u, fragmentation %u%%\n", freeHeap, ESP.getMinFreeHeap(),
+    largest, freeHeap ? 100 - (uint32_t)((uint64_t)largest * 100 / freeHeap) : 0);
+#endif
+
+  memset(scopes, 0, sizeof(scopes));
+}
+
+#endif
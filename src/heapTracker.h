@@ -0,0 +1,69 @@
+/*
+ *  Heap allocation tracker.
+ *
+ *  Build with -D TRACK_HEAP to count heap calls and requested bytes per loop iteration and per mesh callback.  Every
+ *  HEAP_REPORT_SECONDS a summary is printed: calls, average and worst-case allocations and bytes per scope, plus the
+ *  heap's free space, its low-water mark and its largest free block (fragmentation).  Without TRACK_HEAP the macros
+ *  compile to nothing.
+ *
+ *  The counting itself (HEAP_HOOKS, implied by TRACK_HEAP) hooks malloc/calloc/realloc/free: through the linker's
+ *  --wrap on the ESP32 (see [env:esp32dev_heap]), by replacing them outright on glibc hosts.  On the ESP32 only calls
+ *  made from the loop task are counted; WiFi and lwIP allocate from their own tasks all the time.
+ */
+
+#ifndef HEAPTRACKER_H
+#define HEAPTRACKER_H
+
+#include <Arduino.h>
+
+#if defined(TRACK_HEAP) && !defined(HEAP_HOOKS)
+#define HEAP_HOOKS
+#endif
+
+#define HEAP_REPORT_SECONDS 30             // num seconds between heap summaries
+
+struct HeapCounters {
+  uint64_t allocs;                    // malloc, calloc and realloc calls
+  uint64_t frees;
+  uint64_t bytes;                     // requested, not including allocator overhead
+};
+
+extern HeapCounters heapCounters;     // running totals, only moves when HEAP_HOOKS is on
+
+enum HeapScopeId {
+  HEAP_LOOP,
+  HEAP_RECEIVE,
+  HEAP_CHANGED_CONNECTIONS,
+  HEAP_TIME_ADJUSTED,
+  NUM_HEAP_SCOPES
+};
+
+#ifdef TRACK_HEAP
+
+// counts whatever is allocated between its construction and destruction against the given scope
+class HeapScope {
+public:
+  HeapScope(HeapScopeId id) : id(id), start(heapCounters) {}
+  ~HeapScope();
+
+private:
+  HeapScopeId id;
+  HeapCounters start;
+};
+
+#define HEAP_TRACKER_BEGIN()  heapTrackerBegin()
+#define HEAP_SCOPE(id)        HeapScope heapScope(id)
+#define HEAP_REPORT()         heapTrackerReportIfDue()
+
+void heapTrackerBegin();              // start counting allocations made from the calling task
+void heapTrackerReportIfDue();
+
+#else
+
+#define HEAP_TRACKER_BEGIN()
+#define HEAP_SCOPE(id)
+#define HEAP_REPORT()
+
+#endif
+
+#endif
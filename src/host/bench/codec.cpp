@@ -0,0 +1,223 @@
+/*
+ *  [env:bench_codec] -- what each mesh message costs to build and to parse.
+ *
+ *    usage: program [iterations, default 200000]
+ *
+ *  Encode runs the send path the way the firmware calls it (sendMessage(), then the outbox); decode runs
+ *  receivedCallback() on a captured message from the controller, in the current format and in the legacy JSON one,
+ *  and as a duplicate that the dedupe cache drops.  A streamed frame is one full MSG_PIXELS piece, a keyframe of
+ *  PIXELS_PIECE_LEDS pixels that don't compress, put together and shown.  For each message type it reports time per
+ *  message, heap calls and bytes per message, and the size on air: the payload, the payload once painlessMesh escapes
+ *  it into its own JSON package, and the whole package.  This is the baseline protocol changes are measured against.
+ */
+
+#include <stdlib.h>
+
+#include "meshLights.h"
+#include "heapTracker.h"
+#include "host/hal_host.h"
+
+#define CONTROLLER_ID 1000
+#define RECEIVER_ID   2000
+
+// keeps the last message sent, and lets the benchmark pick what time it is on the mesh
+class CaptureTransport : public LoopbackTransport {
+public:
+  CaptureTransport() : LoopbackTransport(CONTROLLER_ID), meshTime(0) {}
+
+  uint32_t getNodeTime() { return meshTime; }
+  bool sendBroadcast(String &msg) { last = msg; return LoopbackTransport::sendBroadcast(msg); }
+
+  uint32_t meshTime;
+  String last;
+};
+
+HostClock hostClock;
+NullLedSink nullSink;
+CaptureTransport capture;
+
+String beaconMessage;
+String keyframeMessage;
+String modeMessage;
+String legacyKeyframeMessage;
+String legacyModeMessage;
+String pixelsMessage;
+
+#define PIXELS_PIECE_LEDS 42            // as many pixels as one run of literals fits in MESSAGE_MAX_DATA bytes
+
+CRGB piecePixels[PIXELS_PIECE_LEDS];
+uint8_t pieceData[MESSAGE_MAX_DATA];
+
+static void encodeBeacon() {
+  sendMessage(MSG_BEACON);
+  outbox.flush(1);
+}
+
+static void encodeKeyframe() {
+  sendMessage(MSG_KEYFRAME);
+  outbox.flush(1);
+}
+
+static void encodeMode() {
+  sendMessage(MSG_DISPLAY_MODE);
+  outbox.flush(1);
+}
+
+// gHue is put back in the correction window every time, so the full resync path runs.  The same message over and over
+// is a duplicate after the first, so the cache is emptied for each one.
+static void decodeBeacon() {
+  gHue = 100;
+  seenMessages.clear();
+  receivedCallback(CONTROLLER_ID, beaconMessage);
+}
+
+static void decodeKeyframe() {
+  gHue = 100;
+  seenMessages.clear();
+  receivedCallback(CONTROLLER_ID, keyframeMessage);
+}
+
+static void decodeMode() {
+  seenMessages.clear();
+  receivedCallback(CONTROLLER_ID, modeMessage);
+}
+
+// and what a flooded copy costs when it's recognized and dropped
+static void dropDuplicate() {
+  receivedCallback(CONTROLLER_ID, keyframeMessage);
+}
+
+// one piece of a frame, the way queueStreamPieces() builds it
+static void encodePixels() {
+  Message msg;
+  char text[OUTBOX_TEXT_SIZE];
+
+  msg.type = MSG_PIXELS;
+  msg.seq = messageSeq++;
+  msg.timestamp = capture.meshTime;
+  msg.frame = 1;
+  msg.base = 1;
+  msg.fragment = 0;
+  msg.fragments = 1;
+  msg.frameSize = rleEncode(piecePixels, nullptr, PIXELS_PIECE_LEDS, pieceData, sizeof(pieceData));
+  msg.data = pieceData;
+  msg.dataSize = msg.frameSize;
+
+  encodeMessage(msg, text, sizeof(text));
+  pixelsMessage = text;
+}
+
+// the frame is forgotten each time, so every piece is put together and shown
+static void decodePixels() {
+  pixelStream.hasFrame = false;
+  receivedCallback(CONTROLLER_ID, pixelsMessage);
+}
+
+static void decodeLegacyKeyframe() {
+  gHue = 100;
+  receivedCallback(CONTROLLER_ID, legacyKeyframeMessage);
+}
+
+static void decodeLegacyMode() {
+  receivedCallback(CONTROLLER_ID, legacyModeMessage);
+}
+
+static String legacy(uint8_t type) {
+  Message msg;
+  char text[64];
+
+  msg.type = type;
+  msg.seq = 0;
+  msg.timestamp = capture.meshTime;
+  msg.mode = displayMode;
+  encodeLegacyMessage(msg, text, sizeof(text));
+  return String(text);
+}
+
+struct Case {
+  const char *name;
+  void (*run)();
+  String *message;                    // what goes over the air, for the size columns
+};
+
+// painlessMesh escapes the payload into a JSON string inside its own package
+static uint32_t escapedLength(const String &payload) {
+  uint32_t length = 0;
+
+  for (unsigned int i = 0; i < payload.length(); i++) {
+    char c = payload[i];
+    length += (c == '"' || c == '\\') ? 2 : 1;
+  }
+
+  return length;
+}
+
+static uint32_t packageLength(const String &payload) {
+  char envelope[96];
+  int overhead = snprintf(envelope, sizeof(envelope), "{\"dest\":0,\"from\":%u,\"type\":8,\"msg\":\"\"}", 4294967295U);
+  return overhead + escapedLength(payload);
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = argc > 1 ? atoi(argv[1]) : 200000;
+
+  localClock = &hostClock;
+  ledSink = &nullSink;
+  meshTransport = &capture;
+  Serial.setOutput(nullptr);
+
+  // as the controller of a small mesh, capture one of each message for the decode runs
+  amController = true;
+  knownControllerID = CONTROLLER_ID;
+  displayMode = CONNECTED;
+  capture.meshTime = 123456789;
+
+  encodeBeacon();
+  beaconMessage = capture.last;
+  encodeKeyframe();
+  keyframeMessage = capture.last;
+  encodeMode();
+  modeMessage = capture.last;
+  legacyKeyframeMessage = legacy(MSG_KEYFRAME);
+  legacyModeMessage = legacy(MSG_DISPLAY_MODE);
+
+  for (uint16_t i = 0; i < PIXELS_PIECE_LEDS; i++) piecePixels[i] = CRGB(i * 6, 255 - i * 6, i * 3);
+  encodePixels();
+
+  // and then as a node that hears them a few milliseconds later
+  capture.meshTime += 3000;
+
+  const Case cases[] = {
+    { "encode beacon",      encodeBeacon,         &beaconMessage },
+    { "encode KEYFRAME",    encodeKeyframe,       &keyframeMessage },
+    { "encode displayMode", encodeMode,           &modeMessage },
+    { "decode beacon",      decodeBeacon,         &beaconMessage },
+    { "decode KEYFRAME",    decodeKeyframe,       &keyframeMessage },
+    { "decode displayMode", decodeMode,           &modeMessage },
+    { "drop duplicate KF",  dropDuplicate,        &keyframeMessage },
+    { "decode legacy KF",   decodeLegacyKeyframe, &legacyKeyframeMessage },
+    { "decode legacy mode", decodeLegacyMode,     &legacyModeMessage },
+    { "encode pixels",      encodePixels,         &pixelsMessage },
+    { "decode pixels",      decodePixels,         &pixelsMessage },
+  };
+
+  printf("%-20s %10s %12s %10s %12s %9s %9s %9s\n", "message", "ns/msg", "msgs/s", "allocs", "heap bytes", "payload", "escaped", "on air");
+
+  for (const Case &c : cases) {
+    HeapCounters before = heapCounters;
+    uint64_t start = hostClock.nanos();
+
+    for (uint32_t i = 0; i < iterations; i++) c.run();
+
+    double ns = (double)(hostClock.nanos() - start) / iterations;
+    double allocs = (double)(heapCounters.allocs - before.allocs) / iterations;
+    double bytes = (double)(heapCounters.bytes - before.bytes) / iterations;
+
+    printf("%-20s %10.1f %12.0f %10.2f %12.1f %9u %9u %9u\n", c.name, ns, 1e9 / ns, allocs, bytes,
+      c.message->length(), escapedLength(*c.message), packageLength(*c.message));
+  }
+
+  printf("\nsample beacon:      %s\nsample KEYFRAME:    %s\nsample displayMode: %s\n", beaconMessage.c_str(),
+    keyframeMessage.c_str(), modeMessage.c_str());
+  return 0;
+}
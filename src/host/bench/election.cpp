@@ -0,0 +1,165 @@
+/*
+ *  [env:bench_election] -- how the controller election and the ALONE/CONNECTED switch hold up while nodes come and go.
+ *
+ *    usage: program
+ *
+ *  Each scenario lets the mesh form for WARMUP_SECONDS, then drops a random node every churn interval (on average)
+ *  and powers it back up after the downtime.  With reconnect set, the dropped node's children are cut off for that
+ *  long before they find the mesh again; with orphans set, connection changes now and then leave a ghost node ID 0 in
+ *  a node's list.  Every SAMPLE_MS it checks, per tree, that exactly the lowest ID thinks it's the controller and
+ *  everyone agrees, and reports:
+ *
+ *    - disruptions: times that stopped being true, and how long it took to come back (time to single leader)
+ *    - flips: amController changes, summed over all nodes, per churn event
+ *    - mode flips: displayMode changes, per churn event
+ *    - alone: node-samples where a node showed ALONE although it had someone else in its tree, and that as a share of
+ *      all node-samples with company
+ */
+
+#include <algorithm>
+
+#include "host/sim/simulator.h"
+
+#define WARMUP_SECONDS 10
+#define SAMPLE_MS      10
+
+struct Scenario {
+  const char *name;
+  uint32_t nodes;
+  uint32_t churnMs;                   // mean time between drops
+  uint32_t downMs;                    // how long a dropped node stays off
+  uint32_t reconnectMs;
+  double orphanChance;
+  uint32_t seconds;
+};
+
+static const Scenario scenarios[] = {
+  // name            nodes  churn   down  reconnect orphans  secs
+  { "steady",           30,     0,     0,      0,   0,        60 },
+  { "slow churn",       30, 10000,  5000,      0,   0,       120 },
+  { "fast churn",       30,  1000,  3000,      0,   0,       120 },
+  { "islands",          30,  5000,  5000,   3000,   0,       120 },
+  { "orphan IDs",       30,  5000,  5000,      0,   0.2,     120 },
+  { "all of it",       100,  1000,  3000,   3000,   0.1,     120 },
+};
+
+struct ElectionStats {
+  uint64_t samples;
+  uint64_t connectedSamples;          // node-samples where the node had company in its tree
+  uint64_t aloneSamples;              // ... and showed ALONE anyway
+  uint32_t flips;
+  uint32_t modeFlips;
+  uint32_t disruptions;
+  std::vector<double> recoveries;     // seconds
+
+  bool disrupted;
+  uint64_t seenChanges;
+  uint64_t since;
+  std::vector<bool> wasController;
+  std::vector<uint8_t> lastMode;
+};
+
+static void sample(Simulator &sim, ElectionStats &e) {
+  std::vector<uint32_t> lowest(sim.nodes.size(), 0xFFFFFFFF);
+  std::vector<uint32_t> size(sim.nodes.size(), 0);
+  bool ok = true;
+  bool warm = sim.now() >= WARMUP_SECONDS * 1000000ULL;
+
+  for (const SimNode &node : sim.nodes) {
+    if (!node.up) continue;
+    lowest[node.root] = std::min(lowest[node.root], node.id);
+    size[node.root]++;
+  }
+
+  for (const SimNode &node : sim.nodes) {
+    if (!node.up) continue;
+
+    bool isLowest = node.id == lowest[node.root];
+    if (node.state.amController != isLowest || (uint32_t)node.state.knownControllerID != lowest[node.root]) ok = false;
+
+    if (warm && size[node.root] > 1) {
+      e.connectedSamples++;
+      if (node.state.displayMode == ALONE) e.aloneSamples++;
+    }
+
+    if (warm && node.state.amController != e.wasController[node.index]) e.flips++;
+    if (warm && node.state.displayMode != e.lastMode[node.index]) e.modeFlips++;
+    e.wasController[node.index] = node.state.amController;
+    e.lastMode[node.index] = node.state.displayMode;
+  }
+
+  e.samples++;
+
+  // the clock starts at the first topology change the mesh hasn't settled from yet
+  if (sim.stats.topologyChanges != e.seenChanges && !e.disrupted) e.since = sim.stats.lastTopologyChangeUs;
+  e.seenChanges = sim.stats.topologyChanges;
+
+  if (!ok && !e.disrupted && warm) {
+    e.disrupted = true;
+    e.disruptions++;
+  }
+  else if (ok && e.disrupted) {
+    e.disrupted = false;
+    e.recoveries.push_back((sim.now() - e.since) / 1e6);
+  }
+}
+
+static double percentile(std::vector<double> &values, double percent) {
+  if (values.empty()) return 0;
+
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t)(percent / 100 * values.size() + 0.999999);
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+int main() {
+  printf("%-12s %5s %6s %11s %9s %9s %9s %10s %10s %7s %9s\n", "scenario", "nodes", "churn", "disruptions",
+    "p50 s", "p99 s", "max s", "flips/ev", "modes/ev", "alone", "alone %");
+
+  bool anyUnresolved = false;
+
+  for (const Scenario &s : scenarios) {
+    SimConfig config;
+    config.nodes = s.nodes;
+    config.seconds = s.seconds;
+    config.reconnectMs = s.reconnectMs;
+    config.orphanChance = s.orphanChance;
+    config.sampleMs = SAMPLE_MS;
+
+    Simulator sim(config);
+    ElectionStats stats = ElectionStats();
+    stats.wasController.assign(s.nodes, false);
+    stats.lastMode.assign(s.nodes, ALONE);
+
+    // churn: drop a random node, bring it back after the downtime
+    uint32_t churnEvents = 0;
+
+    if (s.churnMs > 0) {
+      std::exponential_distribution<double> gap(1.0 / s.churnMs);
+      std::uniform_int_distribution<uint32_t> pick(0, s.nodes - 1);
+      uint64_t end = (uint64_t)s.seconds * 1000000;
+
+      for (uint64_t at = WARMUP_SECONDS * 1000000ULL; at < end; at += gap(sim.rng) * 1000) {
+        uint32_t index = pick(sim.rng);
+        sim.leaveAt(at, index);
+        sim.joinAt(at + s.downMs * 1000ULL, index);
+        churnEvents++;
+      }
+    }
+
+    sim.onSample = [&stats](Simulator &sim) { sample(sim, stats); };
+    sim.run((uint64_t)config.seconds * 1000000);
+
+    uint32_t unresolved = stats.disrupted ? 1 : 0;
+    double perEvent = churnEvents ? churnEvents : 1;
+    anyUnresolved |= unresolved;
+
+    printf("%-12s %5u %6u %8u%s %9.2f %9.2f %9.2f %10.2f %10.2f %7llu %9.3f\n", s.name, s.nodes, churnEvents, stats.disruptions,
+      unresolved ? " (*)" : "    ", percentile(stats.recoveries, 50), percentile(stats.recoveries, 99),
+      percentile(stats.recoveries, 100), stats.flips / perEvent, stats.modeFlips / perEvent,
+      (unsigned long long)stats.aloneSamples, stats.connectedSamples ? 100.0 * stats.aloneSamples / stats.connectedSamples : 0);
+  }
+
+  if (anyUnresolved) printf("\n(*) still disrupted when the run ended\n");
+  return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ *  [env:bench_render] -- how long each effect takes to draw a frame, across strip lengths.
+ *
+ *    usage: program [milliseconds per measurement, default 200]
+ *
+ *  Kernels are the real functions from meshLights.cpp.  "show" is a stand-in for FastLED.show(): it does the per-pixel
+ *  work a clockless driver does before the bits go out (brightness scaling and GRB reordering into an output buffer),
+ *  but not the wire time, which is fixed by the LED protocol at ~30 us per pixel whatever the CPU.
+ *  Built with NUM_LEDS=4096; numLeds is lowered for the shorter strips.
+ */
+
+#include <stdlib.h>
+
+#include "meshLights.h"
+#include "host/hal_host.h"
+
+// what a clockless LED driver does to every pixel before sending it
+class MockShowSink : public LedSink {
+public:
+  MockShowSink() : brightness(BRIGHTNESS), checksum(0) {}
+
+  void setBrightness(uint8_t scale) { brightness = scale; }
+
+  void show(const CRGB *pixels, uint16_t count) {
+    for (uint16_t i = 0; i < count; i++) {
+      out[i * 3 + 0] = scale8(pixels[i].g, brightness);
+      out[i * 3 + 1] = scale8(pixels[i].r, brightness);
+      out[i * 3 + 2] = scale8(pixels[i].b, brightness);
+    }
+
+    checksum += out[(count - 1) * 3];
+  }
+
+  uint8_t brightness;
+  uint32_t checksum;
+  uint8_t out[NUM_LEDS * 3];
+};
+
+HostClock hostClock;
+MockShowSink mockSink;
+LoopbackTransport loopback(1000);
+
+static void kernelConfetti() { confetti(); }
+static void kernelBanana() { banana_mode(); }
+static void kernelRainbow() { stepAnimation(CONNECTED); }
+static void kernelGlitter() { addGlitter(AMOUNT_OF_GLITTER); }
+static void kernelShow() { ledSink->show(leds, numLeds); }
+
+struct Kernel {
+  const char *name;
+  void (*run)();
+};
+
+static const Kernel kernels[] = {
+  { "confetti()",               kernelConfetti },
+  { "banana_mode()",            kernelBanana },
+  { "stepAnimation(CONNECTED)", kernelRainbow },    // fill_rainbow + show
+  { "addGlitter()",             kernelGlitter },
+  { "show (mock)",              kernelShow },
+};
+
+static const uint16_t lengths[] = { 60, 144, 300, 600, 1200, 2400, 4096 };
+
+// run the kernel in batches until the time budget is used up, return ns per call
+static double measure(void (*run)(), uint64_t budgetNs) {
+  uint64_t calls = 0;
+  uint64_t batch = 16;
+  uint64_t start = hostClock.nanos();
+  uint64_t elapsed = 0;
+
+  while (elapsed < budgetNs) {
+    for (uint64_t i = 0; i < batch; i++) run();
+    calls += batch;
+    elapsed = hostClock.nanos() - start;
+    if (batch < 65536) batch *= 2;
+  }
+
+  return (double)elapsed / calls;
+}
+
+int main(int argc, char **argv) {
+  uint64_t budgetNs = (argc > 1 ? atoi(argv[1]) : 200) * 1000000ULL;
+
+  localClock = &hostClock;
+  ledSink = &mockSink;
+  meshTransport = &loopback;
+  Serial.setOutput(nullptr);
+
+  // a connected, non-controller node with an ordinary controller: plain rainbow, no glitter from stepAnimation
+  displayMode = CONNECTED;
+  amController = false;
+  knownControllerID = 1;
+
+  printf("%-26s %6s %12s %10s %12s\n", "kernel", "leds", "ns/frame", "ns/pixel", "frames/s");
+
+  for (const Kernel &kernel : kernels) {
+    for (uint16_t length : lengths) {
+      numLeds = length;
+      fill_solid(leds, NUM_LEDS, CRGB::Black);
+
+      double ns = measure(kernel.run, budgetNs);
+      printf("%-26s %6u %12.0f %10.2f %12.0f\n", kernel.name, length, ns, ns / length, 1e9 / ns);
+    }
+  }
+
+  // keeps the mock sink's work from being optimized away
+  fprintf(stderr, "checksum %u\n", mockSink.checksum);
+  return 0;
+}
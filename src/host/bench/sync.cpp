@@ -0,0 +1,67 @@
+/*
+ *  [env:bench_sync] -- how far apart the nodes' rainbows are, under a fixed set of mesh conditions.
+ *
+ *    usage: program
+ *
+ *  Runs each scenario below in the simulator (fixed seed, so the numbers are repeatable) and measures hue phase error
+ *  against the controller (see sim/syncMetric.h) once the mesh has had WARMUP_SECONDS to form.  A scenario fails when
+ *  its p99 error is worse than its baseline, and the program exits non-zero if any did.  The baselines are the
+ *  measured values plus some headroom; after an intentional change to the sync logic, re-measure and update them.
+ */
+
+#include "host/sim/syncMetric.h"
+
+#define WARMUP_SECONDS 15
+
+struct Scenario {
+  const char *name;
+  uint32_t nodes;
+  double latencyMs;
+  double jitterMs;
+  double loss;
+  double skewPpm;
+  uint32_t seconds;
+  double p99Baseline;                 // hue steps
+};
+
+static const Scenario scenarios[] = {
+  // name          nodes latency jitter  loss  skew  secs  p99
+  { "quiet",          10,   2,      0,   0,      20,   60,  2 },
+  { "typical",        50,   5,      2,   0,      50,   60,  2 },
+  { "lossy",          50,   5,      2,   0.05,   50,   60,  2 },
+  { "slow links",     50,  20,     20,   0,      50,   60,  2 },
+  { "large",         200,   5,      2,   0.02,   50,   60,  2 },
+  { "bad crystals",   50,   5,      2,   0,     200,  120,  3 },
+  { "long drift",     50,   5,      2,   0,     200,  600,  2 },   // long enough for drift.h to fit several adjustments
+};
+
+int main() {
+  bool failed = false;
+
+  printf("%-14s %6s %10s %10s %10s %10s %12s %8s\n", "scenario", "nodes", "mean", "p50", "p99", "max", "p99 baseline", "");
+
+  for (const Scenario &s : scenarios) {
+    SimConfig config;
+    config.nodes = s.nodes;
+    config.latencyMs = s.latencyMs;
+    config.jitterMs = s.jitterMs;
+    config.loss = s.loss;
+    config.skewPpm = s.skewPpm;
+    config.seconds = s.seconds;
+
+    SyncMetric metric(WARMUP_SECONDS * 1000000ULL);
+
+    Simulator sim(config);
+    sim.onSample = [&metric](Simulator &sim) { metric.sample(sim); };
+    sim.run((uint64_t)config.seconds * 1000000);
+
+    double p99 = metric.percentile(99);
+    bool ok = p99 <= s.p99Baseline;
+    failed |= !ok;
+
+    printf("%-14s %6u %10.2f %10.2f %10.2f %10.2f %12.2f %8s\n", s.name, s.nodes, metric.mean(), metric.percentile(50),
+      p99, metric.percentile(100), s.p99Baseline, ok ? "ok" : "WORSE");
+  }
+
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ *  [env:bench_z85] -- what the Z85 text layer (z85.h) costs, per byte, at the sizes the mesh sends.
+ *
+ *    usage: program [iterations, default 200000]
+ *
+ *  For each size it reports the text overhead against the raw bytes, and encode and decode time in ns and TSC ticks
+ *  per byte (x86 only; "-" elsewhere), next to the byte-at-a-time implementation it replaced.  Before timing anything
+ *  it checks that both produce the same text and get the same bytes back, over random data of every length up to 256,
+ *  and that corrupt text is turned away; it exits non-zero if they don't.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "z85.h"
+#include "host/hal_host.h"
+
+#define MAX_BYTES 1024
+
+static inline uint64_t ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+// what z85.cpp did before: a group at a time, a byte at a time, with the short group handled inside the loop and a
+// range check on every character
+static const char referenceDigits[] =
+  "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#";
+
+static const uint8_t referenceDecoder[96] = {
+  0xFF, 0x44, 0xFF, 0x54, 0x53, 0x52, 0x48, 0xFF, 0x4B, 0x4C, 0x46, 0x41, 0xFF, 0x3F, 0x3E, 0x45,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x40, 0xFF, 0x49, 0x42, 0x4A, 0x47,
+  0x51, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32,
+  0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x4D, 0xFF, 0x4E, 0x43, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+  0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x4F, 0xFF, 0x50, 0xFF, 0xFF
+};
+
+static size_t referenceEncode(const uint8_t *data, size_t length, char *out) {
+  size_t written = 0;
+
+  for (size_t i = 0; i < length; i += 4) {
+    size_t group = length - i < 4 ? length - i : 4;
+    uint32_t value = 0;
+
+    for (size_t j = 0; j < 4; j++) value = value << 8 | (j < group ? data[i + j] : 0);
+
+    char chars[5];
+    for (int j = 4; j >= 0; j--) {
+      chars[j] = referenceDigits[value % 85];
+      value /= 85;
+    }
+
+    for (size_t j = 0; j < group + 1; j++) out[written++] = chars[j];
+  }
+
+  return written;
+}
+
+static bool referenceDecode(const char *text, size_t length, uint8_t *out) {
+  size_t written = 0;
+
+  for (size_t i = 0; i < length; i += 5) {
+    size_t group = length - i < 5 ? length - i : 5;
+    if (group == 1) return false;
+
+    uint64_t value = 0;
+    for (size_t j = 0; j < 5; j++) {
+      uint8_t digit = 84;
+
+      if (j < group) {
+        uint8_t c = text[i + j] - 32;
+        if (c >= 96 || referenceDecoder[c] == 0xFF) return false;
+        digit = referenceDecoder[c];
+      }
+
+      value = value * 85 + digit;
+    }
+
+    if (group == 5 && value > 0xFFFFFFFF) return false;
+
+    for (size_t j = 0; j < group - 1; j++) out[written++] = value >> (24 - 8 * j);
+  }
+
+  return true;
+}
+
+uint8_t data[MAX_BYTES];
+uint8_t decoded[MAX_BYTES];
+char text[Z85_ENCODED_SIZE(MAX_BYTES) + 1];
+char referenceText[Z85_ENCODED_SIZE(MAX_BYTES) + 1];
+
+static bool check() {
+  for (size_t length = 0; length <= 256; length++) {
+    for (int round = 0; round < 64; round++) {
+      // all zeros and all ones are where the padding and overflow edges are
+      for (size_t i = 0; i < length; i++) data[i] = round == 0 ? 0 : round == 1 ? 0xFF : rand();
+
+      size_t chars = z85Encode(data, length, text);
+      if (chars != Z85_ENCODED_SIZE(length) || chars != referenceEncode(data, length, referenceText) ||
+        memcmp(text, referenceText, chars) != 0) {
+        printf("!! encode differs at %zu bytes\n", length);
+        return false;
+      }
+
+      if (!z85Decode(text, chars, decoded) || memcmp(decoded, data, length) != 0) {
+        printf("!! decode differs at %zu bytes\n", length);
+        return false;
+      }
+
+      if (chars > 0) {
+        size_t at = rand() % chars;
+        char bad = "\"\\ ~\x01"[rand() % 5];
+        char good = text[at];
+
+        text[at] = bad;
+        if (z85Decode(text, chars, decoded)) {
+          printf("!! accepted a '%c' at %zu of %zu characters\n", bad, at, chars);
+          return false;
+        }
+        text[at] = good;
+      }
+    }
+  }
+
+  // a whole group worth more than 32 bits
+  if (z85Decode("%nSc1", 5, decoded) || z85Decode("#####", 5, decoded) || !z85Decode("%nSc0", 5, decoded)) {
+    printf("!! overflowing group\n");
+    return false;
+  }
+
+  return true;
+}
+
+struct Timing {
+  double ns;
+  double ticks;
+};
+
+template <typename Run>
+static Timing measure(HostClock &clock, uint32_t iterations, size_t bytes, Run run) {
+  uint64_t start = clock.nanos();
+  uint64_t startTicks = ticks();
+
+  for (uint32_t i = 0; i < iterations; i++) run();
+
+  double total = (double)iterations * bytes;
+  return { (clock.nanos() - start) / total, (ticks() - startTicks) / total };
+}
+
+static void printTiming(const Timing &t) {
+  if (t.ticks > 0) printf(" %8.2f %8.2f", t.ns, t.ticks);
+  else printf(" %8.2f %8s", t.ns, "-");
+}
+
+int main(int argc, char **argv) {
+  uint32_t iterations = argc > 1 ? atoi(argv[1]) : 200000;
+  HostClock clock;
+
+  srand(1);
+  if (!check()) return 1;
+
+  // a KEYFRAME, a beacon, a sync, a full MSG_PIXELS piece, and a long run for the steady state
+  const size_t sizes[] = { 12, 20, 21, 148, MAX_BYTES };
+
+  printf("%8s %8s %9s | %17s %17s | %17s %17s\n", "bytes", "chars", "overhead", "encode ns/B tck/B", "reference",
+    "decode ns/B tck/B", "reference");
+
+  for (size_t bytes : sizes) {
+    for (size_t i = 0; i < bytes; i++) data[i] = rand();
+
+    size_t chars = z85Encode(data, bytes, text);
+    uint32_t rounds = (uint32_t)((uint64_t)iterations * 20 / bytes);
+    if (rounds == 0) rounds = 1;
+
+    printf("%8zu %8zu %8.1f%% |", bytes, chars, 100.0 * (chars - bytes) / bytes);
+    printTiming(measure(clock, rounds, bytes, [&] { z85Encode(data, bytes, text); }));
+    printTiming(measure(clock, rounds, bytes, [&] { referenceEncode(data, bytes, referenceText); }));
+    printf(" |");
+    printTiming(measure(clock, rounds, bytes, [&] { z85Decode(text, chars, decoded); }));
+    printTiming(measure(clock, rounds, bytes, [&] { referenceDecode(text, chars, decoded); }));
+    printf("\n");
+  }
+
+  return 0;
+}
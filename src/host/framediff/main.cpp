@@ -0,0 +1,258 @@
+/*
+ *  [env:framediff] -- reads frame captures (see frameCapture.h) back.
+ *
+ *    usage: program <reference> [<other> ...] [--window=32] [--tolerance=0]
+ *
+ *  For every stream: frame count, frame rate, and frame-to-frame interval (mean, p50, p99, max, jitter as the standard
+ *  deviation), from the mesh time of each show().
+ *
+ *  For every other stream, against the reference, two comparisons on each frame that has pixels:
+ *
+ *    - sync offset: the reference frame shown closest to the same mesh time is the "same" frame; the reference frame
+ *      within --window frames of it that looks most like this one (mean channel difference, nearest on ties) is what
+ *      this node is actually showing.  The distance between the two, in frames, is how far behind (positive) or ahead
+ *      this node is.  Reported as mean and p50/p99/max of the absolute offset, also in milliseconds.
+ *    - golden: the largest channel difference between this frame and the same frame.  With --tolerance given, any
+ *      frame over it fails the comparison and the program exits non-zero.  Two captures of the same replay should
+ *      match with --tolerance=0.
+ *
+ *  Mesh time can step back when painlessMesh adjusts it (see frameCapture.h).  The step shows as a negative interval,
+ *  and frames are still matched by the time they were shown.
+ */
+
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "binstream.h"
+#include "frameCapture.h"
+
+struct Frame {
+  uint64_t meshTime;                  // unwrapped
+  int64_t pixels;                     // offset into Stream::pixels, -1 if only the timing was kept
+};
+
+struct Stream {
+  const char *path;
+  uint32_t nodeId;
+  uint16_t count;
+  std::vector<Frame> frames;
+  std::vector<uint8_t> pixels;
+  std::vector<size_t> byTime;         // frame indices in mesh time order, which isn't frame order once time steps back
+  uint32_t stepsBack;                 // how many times it did
+};
+
+static bool load(const char *path, Stream &stream) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "can't read %s\n", path);
+    return false;
+  }
+
+  std::vector<uint8_t> data;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + got);
+  fclose(file);
+
+  BinReader r(data.data(), data.size());
+  const uint8_t *magic = r.getBytes(4);
+  uint8_t version = r.get8();
+
+  stream.path = path;
+  stream.nodeId = r.get32();
+  stream.count = r.get16();
+
+  if (r.overflow || memcmp(magic, "MLFC", 4) != 0 || version != CAPTURE_VERSION) {
+    fprintf(stderr, "%s is not a version %d frame capture\n", path, CAPTURE_VERSION);
+    return false;
+  }
+
+  uint64_t meshTime = 0;
+  stream.stepsBack = 0;
+
+  while (!r.atEnd()) {
+    uint8_t flags = r.get8();
+    meshTime += r.getSigned();        // back, now and then, when painlessMesh adjusts the time
+
+    Frame frame = { meshTime, -1 };
+
+    if (flags & CAPTURE_HAS_PIXELS) {
+      const uint8_t *bytes = r.getBytes((size_t)stream.count * 3);
+      if (!bytes) break;
+
+      frame.pixels = stream.pixels.size();
+      stream.pixels.insert(stream.pixels.end(), bytes, bytes + stream.count * 3);
+    }
+
+    if (r.overflow) break;            // a capture cut off mid-frame keeps everything before it
+    if (!stream.frames.empty() && meshTime < stream.frames.back().meshTime) stream.stepsBack++;
+    stream.frames.push_back(frame);
+  }
+
+  for (size_t i = 0; i < stream.frames.size(); i++) stream.byTime.push_back(i);
+  std::stable_sort(stream.byTime.begin(), stream.byTime.end(),
+    [&stream](size_t a, size_t b) { return stream.frames[a].meshTime < stream.frames[b].meshTime; });
+
+  if (stream.stepsBack) fprintf(stderr, "%s: mesh time stepped back %u time(s)\n", path, stream.stepsBack);
+
+  return true;
+}
+
+static double percentile(std::vector<double> values, double percent) {
+  if (values.empty()) return 0;
+
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t)ceil(percent / 100 * values.size());
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+static void timing(const Stream &s) {
+  std::vector<double> intervals;
+  double sum = 0, squares = 0;
+
+  for (size_t i = 1; i < s.frames.size(); i++) {
+    double ms = (int64_t)(s.frames[i].meshTime - s.frames[i - 1].meshTime) / 1000.0;
+    intervals.push_back(ms);
+    sum += ms;
+    squares += ms * ms;
+  }
+
+  size_t n = intervals.size();
+  double mean = n ? sum / n : 0;
+  double jitter = n ? sqrt(squares / n - mean * mean) : 0;
+  double seconds = n ? (int64_t)(s.frames.back().meshTime - s.frames.front().meshTime) / 1e6 : 0;
+
+  printf("%-24s %10u %8u %8zu %8.1f %9.3f %9.3f %9.3f %9.3f %9.3f\n", s.path, s.nodeId, s.count, s.frames.size(),
+    seconds > 0 ? n / seconds : 0, mean, percentile(intervals, 50), percentile(intervals, 99), percentile(intervals, 100), jitter);
+}
+
+static uint32_t maxDifference(const uint8_t *a, const uint8_t *b, size_t length) {
+  uint32_t worst = 0;
+  for (size_t i = 0; i < length; i++) worst = std::max(worst, (uint32_t)abs(a[i] - b[i]));
+  return worst;
+}
+
+static uint64_t totalDifference(const uint8_t *a, const uint8_t *b, size_t length) {
+  uint64_t total = 0;
+  for (size_t i = 0; i < length; i++) total += abs(a[i] - b[i]);
+  return total;
+}
+
+// index of the reference frame shown closest to the given mesh time
+static size_t nearest(const Stream &ref, uint64_t meshTime) {
+  std::vector<size_t>::const_iterator after = std::lower_bound(ref.byTime.begin(), ref.byTime.end(), meshTime,
+    [&ref](size_t f, uint64_t t) { return ref.frames[f].meshTime < t; });
+
+  size_t i = after - ref.byTime.begin();
+  if (i == ref.byTime.size()) return ref.byTime[i - 1];
+
+  const Frame &later = ref.frames[ref.byTime[i]];
+  if (i > 0 && meshTime - ref.frames[ref.byTime[i - 1]].meshTime < later.meshTime - meshTime) return ref.byTime[i - 1];
+  return ref.byTime[i];
+}
+
+// returns false if any frame is over the tolerance
+static bool compare(const Stream &ref, const Stream &s, uint32_t window, int32_t tolerance) {
+  std::vector<double> offsets, offsetsMs;
+  double offsetSum = 0;
+  uint32_t compared = 0, overTolerance = 0, worst = 0;
+  size_t length = (size_t)s.count * 3;
+
+  for (const Frame &frame : s.frames) {
+    if (frame.pixels < 0 || ref.frames.empty()) continue;
+
+    const uint8_t *mine = &s.pixels[frame.pixels];
+    size_t same = nearest(ref, frame.meshTime);
+
+    // golden: against the frame shown at the same time
+    if (ref.frames[same].pixels >= 0) {
+      uint32_t difference = maxDifference(mine, &ref.pixels[ref.frames[same].pixels], length);
+      worst = std::max(worst, difference);
+      compared++;
+      if (tolerance >= 0 && difference > (uint32_t)tolerance) overTolerance++;
+    }
+
+    // sync: search outwards from the same frame, so ties go to the nearest
+    int64_t best = -1;
+    uint64_t bestScore = UINT64_MAX;
+
+    for (uint32_t d = 0; d <= window && bestScore > 0; d++) {
+      for (int sign = -1; sign <= 1; sign += 2) {
+        if (d == 0 && sign > 0) continue;
+
+        int64_t i = (int64_t)same + sign * (int64_t)d;
+        if (i < 0 || i >= (int64_t)ref.frames.size() || ref.frames[i].pixels < 0) continue;
+
+        uint64_t score = totalDifference(mine, &ref.pixels[ref.frames[i].pixels], length);
+        if (score < bestScore) {
+          bestScore = score;
+          best = i;
+        }
+      }
+    }
+
+    if (best < 0) continue;
+
+    int64_t offset = (int64_t)same - best;      // showing an older reference frame: behind
+    offsetSum += offset;
+    offsets.push_back(fabs((double)offset));
+    offsetsMs.push_back(fabs(((double)ref.frames[same].meshTime - (double)ref.frames[best].meshTime) / 1000.0));
+  }
+
+  printf("%-24s %10u %8u %+8.2f %8.2f %8.2f %8.2f %8.2f %8.2f %8u %8u\n", s.path, s.nodeId, compared,
+    offsets.empty() ? 0 : offsetSum / offsets.size(), percentile(offsets, 50), percentile(offsets, 99),
+    percentile(offsets, 100), percentile(offsetsMs, 50), percentile(offsetsMs, 99), worst, overTolerance);
+
+  return overTolerance == 0;
+}
+
+int main(int argc, char **argv) {
+  std::vector<Stream> streams;
+  uint32_t window = 32;
+  int32_t tolerance = -1;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--window=", 9) == 0) window = atoi(argv[i] + 9);
+    else if (strncmp(argv[i], "--tolerance=", 12) == 0) tolerance = atoi(argv[i] + 12);
+    else if (argv[i][0] == '-') {
+      fprintf(stderr, "unknown option: %s\n", argv[i]);
+      return 2;
+    }
+    else {
+      streams.push_back(Stream());
+      if (!load(argv[i], streams.back())) return 2;
+    }
+  }
+
+  if (streams.empty()) {
+    fprintf(stderr, "usage: %s <reference> [<other> ...] [--window=32] [--tolerance=0]\n", argv[0]);
+    return 2;
+  }
+
+  printf("%-24s %10s %8s %8s %8s %9s %9s %9s %9s %9s\n", "stream", "node", "pixels", "frames", "fps",
+    "mean ms", "p50 ms", "p99 ms", "max ms", "jitter");
+  for (const Stream &s : streams) timing(s);
+
+  if (streams.size() < 2) return 0;
+
+  bool ok = true;
+
+  printf("\nagainst %s (offset in frames, + is behind):\n", streams[0].path);
+  printf("%-24s %10s %8s %8s %8s %8s %8s %8s %8s %8s %8s\n", "stream", "node", "compared", "mean", "p50", "p99", "max",
+    "p50 ms", "p99 ms", "max diff", "failed");
+
+  for (size_t i = 1; i < streams.size(); i++) {
+    if (streams[i].count != streams[0].count) {
+      printf("%-24s %u pixels per frame, the reference has %u: not comparable\n", streams[i].path, streams[i].count, streams[0].count);
+      ok = false;
+      continue;
+    }
+
+    ok &= compare(streams[0], streams[i], window, tolerance);
+  }
+
+  return ok ? 0 : 1;
+}
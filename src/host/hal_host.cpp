@@ -0,0 +1,13 @@
+#include "hal_host.h"
+
+#include <chrono>
+
+static uint64_t steadyNanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+HostClock::HostClock() : start(steadyNanos()) {}
+
+uint32_t HostClock::millis() { return nanos() / 1000000; }
+uint32_t HostClock::micros() { return nanos() / 1000; }
+uint64_t HostClock::nanos() { return steadyNanos() - start; }
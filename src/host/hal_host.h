@@ -0,0 +1,88 @@
+/*
+ *  HAL implementations for host builds: clocks, LED sinks, a single-node mesh transport and a trace file.
+ */
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+#include <stdio.h>
+
+#include "hal.h"
+#include "traceRecorder.h"
+
+// wall clock, counted from construction
+class HostClock : public Clock {
+public:
+  HostClock();
+  uint32_t millis();
+  uint32_t micros();
+  uint32_t cycles() { return nanos(); }
+  uint32_t cyclesPerMicro() { return 1000; }
+  uint64_t nanos();
+
+private:
+  uint64_t start;
+};
+
+// time only moves when someone says so
+class VirtualClock : public Clock {
+public:
+  VirtualClock() : now(0) {}
+  uint32_t millis() { return now / 1000; }
+  uint32_t micros() { return now; }
+
+  void set(uint64_t us) { now = us; }
+  void advance(uint64_t us) { now += us; }
+  uint64_t get() const { return now; }
+
+private:
+  uint64_t now;
+};
+
+// throws frames away, but counts them
+class NullLedSink : public LedSink {
+public:
+  NullLedSink() : frames(0), brightness(255) {}
+  void setBrightness(uint8_t scale) { brightness = scale; }
+  void show(const CRGB *pixels, uint16_t count) { frames++; }
+
+  uint32_t frames;
+  uint8_t brightness;
+};
+
+// a mesh where nobody else talks.  Broadcasts are counted and dropped; mesh time is the local clock.  Adding silent
+// peers makes the node behave as if it were connected (rainbow mode, elections, beacons).
+class LoopbackTransport : public MeshTransport {
+public:
+  LoopbackTransport(uint32_t nodeId) : nodeId(nodeId), messagesSent(0), bytesSent(0) {}
+
+  void update() {}
+  uint32_t getNodeId() { return nodeId; }
+  uint32_t getNodeTime() { return localClock->micros(); }
+  SimpleList<uint32_t> getNodeList() { return peers; }
+  bool sendBroadcast(String &msg) { messagesSent++; bytesSent += msg.length(); return true; }
+  bool sendSingle(uint32_t dest, String &msg) { return sendBroadcast(msg); }
+  String subConnectionJson() { return String("[]"); }
+
+  int32_t rssi() { return 0; }
+  String localIP() { return String("0.0.0.0"); }
+  const char* linkMode() { return "HOST"; }
+  const char* linkStatus() { return "LOOPBACK"; }
+
+  uint32_t nodeId;
+  SimpleList<uint32_t> peers;
+  uint32_t messagesSent;
+  uint32_t bytesSent;
+};
+
+// mesh traces (traceRecorder.h) go to an open file
+class FileTraceOutput : public TraceOutput {
+public:
+  FileTraceOutput(FILE *file) : file(file) {}
+  void write(const uint8_t *data, size_t length) { fwrite(data, 1, length, file); }
+  void flush() { fflush(file); }
+
+  FILE *file;
+};
+
+#endif
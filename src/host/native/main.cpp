@@ -0,0 +1,52 @@
+/*
+ *  [env:native] -- runs one node's loop on the host as fast as it will go.
+ *
+ *    usage: program [seconds] [peers]
+ *
+ *  With peers > 0 the node thinks it's connected to that many (silent) nodes, so it elects itself controller, renders
+ *  the rainbow and sends beacons.  Serial output is suppressed while running (unless built with PROFILE_LOOP or
+ *  TRACK_HEAP); a throughput summary is printed at the end.
+ */
+
+#include <stdlib.h>
+
+#include "meshLights.h"
+#include "heapTracker.h"
+#include "host/hal_host.h"
+
+int main(int argc, char **argv) {
+  uint32_t seconds = argc > 1 ? atoi(argv[1]) : 5;
+  uint32_t peers = argc > 2 ? atoi(argv[2]) : 1;
+
+  HostClock clock;
+  NullLedSink sink;
+  LoopbackTransport transport(1000);
+
+  for (uint32_t i = 0; i < peers; i++) transport.peers.push_back(2000 + i);
+
+  localClock = &clock;
+  ledSink = &sink;
+  meshTransport = &transport;
+
+#if !defined(PROFILE_LOOP) && !defined(TRACK_HEAP)
+  Serial.setOutput(nullptr);          // profile and heap builds keep it, for the periodic summaries
+#endif
+  HEAP_TRACKER_BEGIN();
+  changedConnectionCallback();
+
+  uint64_t loops = 0;
+  uint64_t end = (uint64_t)seconds * 1000000000ULL;
+
+  while (clock.nanos() < end) {
+    stepLoop();
+    loops++;
+  }
+
+  Serial.setOutput(stdout);
+  Serial.printf("node %u, %u peer(s), %s, ran %u s\n", transport.nodeId, peers, amController ? "controller" : "member", seconds);
+  Serial.printf(" . loops:    %llu (%.0f/s)\n", (unsigned long long)loops, loops / (double)seconds);
+  Serial.printf(" . frames:   %u (%.0f/s)\n", sink.frames, sink.frames / (double)seconds);
+  Serial.printf(" . messages: %u sent, %u bytes\n", transport.messagesSent, transport.bytesSent);
+
+  return 0;
+}
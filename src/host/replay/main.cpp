@@ -0,0 +1,252 @@
+/*
+ *  [env:replay] -- plays a recorded mesh trace (see traceRecorder.h) back through the logic.
+ *
+ *    usage: program <trace file> [--tick-us=1000] [--frames=<file>] [--verbose]
+ *
+ *  Time is virtual: stepLoop() runs every --tick-us of the node's own clock and every recorded callback is delivered
+ *  at the local time it was recorded, with the mesh time and node list the node saw then.  The same trace and tick
+ *  always give the same run, down to the state hash printed at the end.  The profiler and the CPU time columns use
+ *  the host's real clock, so a replay_profile build shows where the time would have gone that night.
+ *
+ *  --frames captures every frame the replay renders (see frameCapture.h), for framediff: two replays of the same
+ *  trace should produce identical streams, which makes a capture a golden image for the effects.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "meshLights.h"
+#include "binstream.h"
+#include "frameCapture.h"
+#include "host/hal_host.h"
+
+// virtual time for the logic, real time for the profiler
+class ReplayClock : public VirtualClock {
+public:
+  uint32_t cycles() { return host.nanos(); }
+  uint32_t cyclesPerMicro() { return 1000; }
+
+  HostClock host;
+};
+
+// the mesh as the recorded node saw it
+class ReplayTransport : public LoopbackTransport {
+public:
+  ReplayTransport(uint32_t nodeId) : LoopbackTransport(nodeId), meshOffset(0) {}
+
+  uint32_t getNodeTime() { return localClock->micros() + meshOffset; }
+
+  int32_t meshOffset;                 // mesh time - local time
+};
+
+struct EventStats {
+  const char *name;
+  uint32_t count;
+  uint64_t nanos;
+  uint64_t maxNanos;
+};
+
+// FNV-1a over the state that matters after every event, so two replays can be compared at a glance
+static uint64_t stateHash = 14695981039346656037ULL;
+
+static void hashState() {
+  uint8_t state[] = { gHue, displayMode, amController, (uint8_t)knownControllerID, (uint8_t)(knownControllerID >> 8),
+    (uint8_t)(knownControllerID >> 16), (uint8_t)(knownControllerID >> 24) };
+
+  for (uint8_t b : state) stateHash = (stateHash ^ b) * 1099511628211ULL;
+}
+
+static bool option(const char *arg, const char *name, double &value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') return false;
+
+  value = atof(arg + length + 1);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const char *path = nullptr;
+  const char *framesPath = nullptr;
+  uint32_t tickUs = 1000;
+  bool verbose = false;
+
+  for (int i = 1; i < argc; i++) {
+    double v;
+
+    if (option(argv[i], "--tick-us", v)) tickUs = v > 0 ? v : 1;
+    else if (strncmp(argv[i], "--frames=", 9) == 0) framesPath = argv[i] + 9;
+    else if (strcmp(argv[i], "--verbose") == 0) verbose = true;
+    else if (argv[i][0] != '-' && !path) path = argv[i];
+    else {
+      fprintf(stderr, "unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  if (!path) {
+    fprintf(stderr, "usage: %s <trace file> [--tick-us=1000] [--frames=<file>] [--verbose]\n", argv[0]);
+    return 2;
+  }
+
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "can't read %s\n", path);
+    return 2;
+  }
+
+  std::vector<uint8_t> trace;
+  uint8_t chunk[4096];
+  size_t got;
+  while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) trace.insert(trace.end(), chunk, chunk + got);
+  fclose(file);
+
+  BinReader r(trace.data(), trace.size());
+  const uint8_t *magic = r.getBytes(4);
+  uint8_t version = r.get8();
+  uint32_t nodeId = r.get32();
+
+  if (r.overflow || memcmp(magic, "MLTR", 4) != 0 || version != TRACE_VERSION) {
+    fprintf(stderr, "%s is not a version %d mesh trace\n", path, TRACE_VERSION);
+    return 2;
+  }
+
+  ReplayClock clock;
+  ReplayTransport transport(nodeId);
+  NullLedSink sink;
+  CaptureLedSink capture(&sink);
+  FILE *framesFile = nullptr;
+  FileTraceOutput framesOutput(nullptr);
+
+  localClock = &clock;
+  meshTransport = &transport;
+  ledSink = &sink;
+
+  if (framesPath) {
+    framesFile = fopen(framesPath, "wb");
+    if (!framesFile) {
+      fprintf(stderr, "can't write %s\n", framesPath);
+      return 2;
+    }
+
+    framesOutput.file = framesFile;
+    capture.maxBytes = 0xFFFFFFFF;
+    capture.begin(&framesOutput, nodeId, numLeds);
+    ledSink = &capture;
+  }
+
+  Serial.setOutput(verbose ? stdout : nullptr);
+  resetNodeState();
+
+  EventStats stats[4] = {};
+  stats[0].name = "loop";
+  stats[1].name = "received";
+  stats[2].name = "changed";
+  stats[3].name = "timeAdjusted";
+  EventStats &loops = stats[0];
+  uint64_t now = 0;
+  uint64_t nextTick = tickUs;
+  uint64_t started = clock.host.nanos();
+
+  while (!r.atEnd()) {
+    uint8_t type = r.get8();
+    uint64_t at = now + r.getVarint();
+    int32_t offset = transport.meshOffset + (int32_t)r.getSigned();
+
+    // run the loop up to the moment the event happened
+    while (nextTick <= at) {
+      clock.set(nextTick);
+
+      uint64_t t = clock.host.nanos();
+      stepLoop();
+      t = clock.host.nanos() - t;
+
+      loops.count++;
+      loops.nanos += t;
+      if (t > loops.maxNanos) loops.maxNanos = t;
+
+      hashState();
+      nextTick += tickUs;
+    }
+
+    now = at;
+    clock.set(now);
+    transport.meshOffset = offset;
+
+    // decode first, so only the callback itself is timed
+    uint32_t from = 0;
+    String msg;
+    int32_t adjustment = 0;
+
+    switch (type) {
+      case TRACE_RECEIVED: {
+        from = r.get32();
+        uint32_t length = r.getVarint();
+        const uint8_t *bytes = r.getBytes(length);
+        if (!bytes) break;
+
+        msg.reserve(length);
+        for (uint32_t i = 0; i < length; i++) msg += (char)bytes[i];
+      }
+      break;
+
+      case TRACE_CHANGED: {
+        uint32_t count = r.getVarint();
+
+        transport.peers.clear();
+        for (uint32_t i = 0; i < count && !r.overflow; i++) transport.peers.push_back(r.get32());
+      }
+      break;
+
+      case TRACE_TIME_ADJUSTED:
+        adjustment = r.getSigned();
+      break;
+
+      default:
+        fprintf(stderr, "unknown record type %u at byte %u\n", type, (uint32_t)r.position - 1);
+        return 2;
+    }
+
+    if (r.overflow) {
+      fprintf(stderr, "trace ends in the middle of a record\n");
+      break;
+    }
+
+    uint64_t t = clock.host.nanos();
+
+    if (type == TRACE_RECEIVED) receivedCallback(from, msg);
+    else if (type == TRACE_CHANGED) changedConnectionCallback();
+    else nodeTimeAdjustedCallback(adjustment);
+
+    t = clock.host.nanos() - t;
+
+    EventStats &s = stats[type];
+    s.count++;
+    s.nanos += t;
+    if (t > s.maxNanos) s.maxNanos = t;
+
+    hashState();
+  }
+
+  double wall = (clock.host.nanos() - started) / 1e9;
+
+  if (framesFile) {
+    capture.end();
+    fclose(framesFile);
+  }
+
+  Serial.setOutput(stdout);
+  Serial.printf("replayed %s: node %u, %.2f s of trace in %.2f s wall, tick %u us\n", path, nodeId, now / 1e6, wall, tickUs);
+  Serial.printf("   %-14s %10s %12s %12s\n", "event", "count", "mean ns", "max ns");
+
+  for (const EventStats &s : stats) {
+    if (s.count == 0) continue;
+    Serial.printf("   %-14s %10u %12.0f %12llu\n", s.name, s.count, (double)s.nanos / s.count, (unsigned long long)s.maxNanos);
+  }
+
+  Serial.printf(" . end state: gHue %u, mode %u, %s (controller %u), %u frames, %u messages sent\n", gHue, displayMode,
+    amController ? "controller" : "member", (uint32_t)knownControllerID, sink.frames, transport.messagesSent);
+  Serial.printf(" . state hash: %016llx\n", (unsigned long long)stateHash);
+
+  return 0;
+}
@@ -0,0 +1,48 @@
+/*
+ *  Host stand-in for <Arduino.h>.
+ *
+ *  Provides the handful of core functions meshLights uses.  Time comes from the HAL clock (localClock), so a host
+ *  build decides whether "millis()" is the wall clock or a simulated one.
+ */
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "WString.h"
+
+uint32_t millis();
+uint32_t micros();
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+// Serial goes to stdout by default.  setOutput(nullptr) silences it, which the simulator does for all but one node.
+class HardwareSerial {
+public:
+  HardwareSerial() : out(stdout) {}
+
+  void begin(unsigned long baud) {}
+  void setOutput(FILE *stream) { out = stream; }
+  FILE * getOutput() const { return out; }
+  operator bool() const { return out != nullptr; }       // always true on the ESP32; false here while muted
+
+  int printf(const char *format, ...);
+  size_t print(const char *str);
+  size_t print(const String &str) { return print(str.c_str()); }
+  size_t println(const char *str = "");
+  size_t println(const String &str) { return println(str.c_str()); }
+
+private:
+  FILE *out;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ *  Host stand-in for <FastLED.h>.
+ *
+ *  The color math (hsv2rgb_rainbow, fill_rainbow, fill_gradient, nscale8, random8/16) follows FastLED's portable C
+ *  implementations, so host timings and frames track what the ESP32 renders.  There's no controller or show() here:
+ *  frames leave through the LedSink in hal.h.
+ */
+
+#ifndef HOST_FASTLED_H
+#define HOST_FASTLED_H
+
+#include <Arduino.h>
+
+typedef uint8_t fract8;
+
+// 8-bit math
+inline uint8_t qadd8(uint8_t i, uint8_t j) { unsigned t = i + j; return t > 255 ? 255 : t; }
+inline uint8_t scale8(uint8_t i, fract8 scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+inline uint8_t scale8_video(uint8_t i, fract8 scale) { return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0); }
+
+// random numbers, same generator as FastLED's lib8tion
+extern uint16_t rand16seed;
+
+inline uint16_t random16() { rand16seed = (rand16seed * 2053) + 13849; return rand16seed; }
+inline uint16_t random16(uint16_t lim) { return ((uint32_t)random16() * lim) >> 16; }
+inline uint8_t random8() { random16(); return (uint8_t)(((uint8_t)(rand16seed & 0xFF)) + ((uint8_t)(rand16seed >> 8))); }
+inline uint8_t random8(uint8_t lim) { return (random8() * lim) >> 8; }
+inline void random16_set_seed(uint16_t seed) { rand16seed = seed; }
+
+struct CHSV {
+  union {
+    struct { union { uint8_t hue; uint8_t h; }; union { uint8_t sat; uint8_t s; }; union { uint8_t val; uint8_t v; }; };
+    uint8_t raw[3];
+  };
+
+  CHSV() {}
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : hue(ih), sat(is), val(iv) {}
+};
+
+struct CRGB;
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb);
+
+struct CRGB {
+  union {
+    struct { union { uint8_t r; uint8_t red; }; union { uint8_t g; uint8_t green; }; union { uint8_t b; uint8_t blue; }; };
+    uint8_t raw[3];
+  };
+
+  typedef enum { Black = 0x000000, White = 0xFFFFFF } HTMLColorCode;
+
+  CRGB() {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t colorcode) : r((colorcode >> 16) & 0xFF), g((colorcode >> 8) & 0xFF), b(colorcode & 0xFF) {}
+  CRGB(HTMLColorCode colorcode) : CRGB((uint32_t)colorcode) {}
+  CRGB(const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); }
+
+  CRGB & operator = (const CHSV &rhs) { hsv2rgb_rainbow(rhs, *this); return *this; }
+  CRGB & operator += (const CRGB &rhs) { r = qadd8(r, rhs.r); g = qadd8(g, rhs.g); b = qadd8(b, rhs.b); return *this; }
+  CRGB & nscale8(uint8_t scale) { r = scale8(r, scale); g = scale8(g, scale); b = scale8(b, scale); return *this; }
+  bool operator == (const CRGB &rhs) const { return r == rhs.r && g == rhs.g && b == rhs.b; }
+  bool operator != (const CRGB &rhs) const { return !(*this == rhs); }
+};
+
+// fills and fades
+enum TGradientDirectionCode { FORWARD_HUES, BACKWARD_HUES, SHORTEST_HUES, LONGEST_HUES };
+
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color);
+void fill_rainbow(CRGB *leds, int numToFill, uint8_t initialhue, uint8_t deltahue = 5);
+void fill_gradient(CRGB *leds, uint16_t numLeds, const CHSV &c1, const CHSV &c2, TGradientDirectionCode directionCode = SHORTEST_HUES);
+void nscale8(CRGB *leds, uint16_t numLeds, uint8_t scale);
+void fadeToBlackBy(CRGB *leds, uint16_t numLeds, uint8_t fadeBy);
+
+// EVERY_N_MILLISECONDS / EVERY_N_SECONDS, driven by millis() like the real thing
+#define INSTANTIATE_EVERY_N_TIME_PERIODS(NAME, TIMETYPE, TIMEGETTER) \
+class NAME { \
+public: \
+  TIMETYPE mPrevTrigger; \
+  TIMETYPE mPeriod; \
+  NAME() { reset(); mPeriod = 1; } \
+  NAME(TIMETYPE period) { reset(); setPeriod(period); } \
+  void setPeriod(TIMETYPE period) { mPeriod = period; } \
+  TIMETYPE getTime() { return (TIMETYPE)(TIMEGETTER()); } \
+  TIMETYPE getPeriod() { return mPeriod; } \
+  TIMETYPE getElapsed() { return getTime() - mPrevTrigger; } \
+  TIMETYPE getRemaining() { return mPeriod - getElapsed(); } \
+  TIMETYPE getLastTriggerTime() { return mPrevTrigger; } \
+  bool ready() { bool isReady = (getElapsed() >= mPeriod); if (isReady) { reset(); } return isReady; } \
+  void reset() { mPrevTrigger = getTime(); } \
+  void trigger() { mPrevTrigger = getTime() - mPeriod; } \
+  operator bool() { return ready(); } \
+};
+
+inline uint16_t seconds16() { return millis() / 1000; }
+
+INSTANTIATE_EVERY_N_TIME_PERIODS(CEveryNMillis, uint32_t, millis);
+INSTANTIATE_EVERY_N_TIME_PERIODS(CEveryNSeconds, uint16_t, seconds16);
+
+#define CONCAT_HELPER(x, y) x##y
+#define CONCAT_MACRO(x, y) CONCAT_HELPER(x, y)
+#define EVERY_N_MILLISECONDS_I(NAME, N) static CEveryNMillis NAME(N); if (NAME)
+#define EVERY_N_SECONDS_I(NAME, N) static CEveryNSeconds NAME(N); if (NAME)
+#define EVERY_N_MILLISECONDS(N) EVERY_N_MILLISECONDS_I(CONCAT_MACRO(PER, __COUNTER__), N)
+#define EVERY_N_SECONDS(N) EVERY_N_SECONDS_I(CONCAT_MACRO(PER, __COUNTER__), N)
+
+#endif
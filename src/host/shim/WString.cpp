@@ -0,0 +1,190 @@
+#include "WString.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+String::String(const char *cstr) {
+  init();
+  if (cstr) copy(cstr, strlen(cstr));
+}
+
+String::String(const String &str) {
+  init();
+  *this = str;
+}
+
+String::String(String &&str) {
+  buffer = str.buffer;
+  capacity = str.capacity;
+  len = str.len;
+  str.init();
+}
+
+String::String(char c) {
+  init();
+  char buf[2] = { c, 0 };
+  *this = buf;
+}
+
+// all the integer constructors funnel through here
+static void formatInteger(char *buf, size_t size, unsigned long long magnitude, bool negative, unsigned char base) {
+  char digits[66];
+  int i = 0;
+
+  do {
+    unsigned digit = magnitude % base;
+    digits[i++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    magnitude /= base;
+  } while (magnitude > 0);
+
+  size_t n = 0;
+  if (negative && n + 1 < size) buf[n++] = '-';
+  while (i > 0 && n + 1 < size) buf[n++] = digits[--i];
+  buf[n] = 0;
+}
+
+String::String(int value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned int value, unsigned char base) : String((unsigned long long)value, base) {}
+String::String(long value, unsigned char base) : String((long long)value, base) {}
+String::String(unsigned long value, unsigned char base) : String((unsigned long long)value, base) {}
+
+String::String(long long value, unsigned char base) {
+  init();
+  char buf[68];
+  bool negative = value < 0 && base == 10;
+  formatInteger(buf, sizeof(buf), negative ? 0ULL - (unsigned long long)value : (unsigned long long)value, negative, base);
+  *this = buf;
+}
+
+String::String(unsigned long long value, unsigned char base) {
+  init();
+  char buf[68];
+  formatInteger(buf, sizeof(buf), value, false, base);
+  *this = buf;
+}
+
+String::~String() {
+  free(buffer);
+}
+
+void String::init() {
+  buffer = nullptr;
+  capacity = 0;
+  len = 0;
+}
+
+void String::invalidate() {
+  free(buffer);
+  init();
+}
+
+bool String::reserve(unsigned int size) {
+  if (buffer && capacity >= size) return true;
+
+  char *grown = (char *)realloc(buffer, size + 1);
+  if (!grown) return false;
+
+  if (!buffer) grown[0] = 0;
+  buffer = grown;
+  capacity = size;
+  return true;
+}
+
+bool String::copy(const char *cstr, unsigned int length) {
+  if (!reserve(length)) {
+    invalidate();
+    return false;
+  }
+
+  len = length;
+  memcpy(buffer, cstr, length);
+  buffer[len] = 0;
+  return true;
+}
+
+String & String::operator = (const String &rhs) {
+  if (this == &rhs) return *this;
+
+  if (rhs.buffer) copy(rhs.buffer, rhs.len);
+  else invalidate();
+
+  return *this;
+}
+
+String & String::operator = (String &&rhs) {
+  if (this != &rhs) {
+    free(buffer);
+    buffer = rhs.buffer;
+    capacity = rhs.capacity;
+    len = rhs.len;
+    rhs.init();
+  }
+
+  return *this;
+}
+
+String & String::operator = (const char *cstr) {
+  if (cstr) copy(cstr, strlen(cstr));
+  else invalidate();
+
+  return *this;
+}
+
+bool String::concat(const char *cstr, unsigned int length) {
+  if (!cstr) return false;
+  if (length == 0) return true;
+  if (!reserve(len + length)) return false;
+
+  memmove(buffer + len, cstr, length);
+  len += length;
+  buffer[len] = 0;
+  return true;
+}
+
+bool String::concat(const String &str) { return concat(str.c_str(), str.len); }
+bool String::concat(const char *cstr) { return cstr ? concat(cstr, strlen(cstr)) : false; }
+bool String::concat(char c) { return concat(&c, 1); }
+
+bool String::equals(const char *cstr) const {
+  return strcmp(c_str(), cstr ? cstr : "") == 0;
+}
+
+int String::indexOf(char c, unsigned int fromIndex) const {
+  if (fromIndex >= len) return -1;
+
+  const char *found = strchr(buffer + fromIndex, c);
+  return found ? found - buffer : -1;
+}
+
+String String::substring(unsigned int beginIndex, unsigned int endIndex) const {
+  if (beginIndex > endIndex) { unsigned int swap = beginIndex; beginIndex = endIndex; endIndex = swap; }
+  if (beginIndex >= len) return String();
+  if (endIndex > len) endIndex = len;
+
+  String out;
+  out.copy(buffer + beginIndex, endIndex - beginIndex);
+  return out;
+}
+
+long String::toInt() const {
+  return buffer ? atol(buffer) : 0;
+}
+
+String operator + (const String &lhs, const String &rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator + (const String &lhs, const char *rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
+
+String operator + (const char *lhs, const String &rhs) {
+  String out(lhs);
+  out.concat(rhs);
+  return out;
+}
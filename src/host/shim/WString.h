@@ -0,0 +1,77 @@
+/*
+ *  Host stand-in for the Arduino String class.
+ *
+ *  Only what meshLights uses.  Like the Arduino core, the text lives in a single
+ *  malloc()/realloc()'d buffer, so allocation counts measured on the host look like the ones on the ESP32.
+ */
+
+#ifndef HOST_WSTRING_H
+#define HOST_WSTRING_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+class String {
+public:
+  String(const char *cstr = "");
+  String(const String &str);
+  String(String &&str);
+  explicit String(char c);
+  explicit String(int value, unsigned char base = 10);
+  explicit String(unsigned int value, unsigned char base = 10);
+  explicit String(long value, unsigned char base = 10);
+  explicit String(unsigned long value, unsigned char base = 10);
+  explicit String(long long value, unsigned char base = 10);
+  explicit String(unsigned long long value, unsigned char base = 10);
+  ~String();
+
+  String & operator = (const String &rhs);
+  String & operator = (String &&rhs);
+  String & operator = (const char *cstr);
+
+  bool reserve(unsigned int size);
+  unsigned int length() const { return len; }
+  const char * c_str() const { return buffer ? buffer : ""; }
+
+  bool concat(const String &str);
+  bool concat(const char *cstr);
+  bool concat(const char *cstr, unsigned int length);
+  bool concat(char c);
+  String & operator += (const String &rhs) { concat(rhs); return *this; }
+  String & operator += (const char *cstr) { concat(cstr); return *this; }
+  String & operator += (char c) { concat(c); return *this; }
+
+  bool equals(const char *cstr) const;
+  bool operator == (const String &rhs) const { return equals(rhs.c_str()); }
+  bool operator == (const char *cstr) const { return equals(cstr); }
+  bool operator != (const String &rhs) const { return !equals(rhs.c_str()); }
+  bool operator != (const char *cstr) const { return !equals(cstr); }
+
+  char charAt(unsigned int index) const { return index < len ? buffer[index] : 0; }
+  char operator [] (unsigned int index) const { return charAt(index); }
+  int indexOf(char c, unsigned int fromIndex = 0) const;
+  String substring(unsigned int beginIndex, unsigned int endIndex) const;
+  long toInt() const;
+
+private:
+  char *buffer;
+  unsigned int capacity;
+  unsigned int len;
+
+  void init();
+  void invalidate();
+  bool copy(const char *cstr, unsigned int length);
+};
+
+// exists on Arduino, and libraries refer to it by name
+class StringSumHelper : public String {
+public:
+  StringSumHelper(const String &s) : String(s) {}
+  StringSumHelper(const char *p) : String(p) {}
+};
+
+String operator + (const String &lhs, const String &rhs);
+String operator + (const String &lhs, const char *rhs);
+String operator + (const char *lhs, const String &rhs);
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ *  Host implementations behind the Arduino.h and FastLED.h stand-ins.
+ */
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include <stdarg.h>
+
+#include "hal.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// ARDUINO CORE
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+HardwareSerial Serial;
+
+// before a host build installs its clock (static initializers, mostly) time stands still at zero
+uint32_t millis() { return localClock ? localClock->millis() : 0; }
+uint32_t micros() { return localClock ? localClock->micros() : 0; }
+
+// xorshift32, seeded the same way every run unless randomSeed() says otherwise, so host runs are repeatable
+static uint32_t randomState = 2463534242UL;
+
+void randomSeed(unsigned long seed) {
+  randomState = seed ? seed : 2463534242UL;
+}
+
+long random(long howbig) {
+  if (howbig <= 0) return 0;
+
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+  return randomState % howbig;
+}
+
+long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+
+int HardwareSerial::printf(const char *format, ...) {
+  if (!out) return 0;
+
+  va_list args;
+  va_start(args, format);
+  int written = vfprintf(out, format, args);
+  va_end(args);
+  return written;
+}
+
+size_t HardwareSerial::print(const char *str) {
+  if (!out) return 0;
+
+  fputs(str, out);
+  return strlen(str);
+}
+
+size_t HardwareSerial::println(const char *str) {
+  return out ? fprintf(out, "%s\n", str) : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// FASTLED
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t rand16seed = 1337;
+
+// FastLED's "rainbow" hue mapping (hsv2rgb.cpp), with its default settings: Y1 yellow boost, no green scaling
+void hsv2rgb_rainbow(const CHSV &hsv, CRGB &rgb) {
+  uint8_t hue = hsv.hue;
+  uint8_t sat = hsv.sat;
+  uint8_t val = hsv.val;
+
+  uint8_t offset8 = (hue & 0x1F) << 3;
+  uint8_t third = scale8(offset8, (256 / 3));
+  uint8_t r, g, b;
+
+  if (!(hue & 0x80)) {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) { r = 255 - third; g = third; b = 0; }                                    // R -> O
+      else { r = 171; g = 85 + third; b = 0; }                                                     // O -> Y
+    }
+    else {
+      if (!(hue & 0x20)) { uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); r = 171 - twothirds; g = 170 + third; b = 0; }   // Y -> G
+      else { r = 0; g = 255 - third; b = third; }                                                  // G -> A
+    }
+  }
+  else {
+    if (!(hue & 0x40)) {
+      if (!(hue & 0x20)) { uint8_t twothirds = scale8(offset8, ((256 * 2) / 3)); r = 0; g = 171 - twothirds; b = 85 + twothirds; } // A -> B
+      else { r = third; g = 0; b = 255 - third; }                                                  // B -> P
+    }
+    else {
+      if (!(hue & 0x20)) { r = 85 + third; g = 0; b = 171 - third; }                               // P -> K
+      else { r = 170 + third; g = 0; b = 85 - third; }                                             // K -> R
+    }
+  }
+
+  // desaturate towards white
+  if (sat != 255) {
+    if (sat == 0) {
+      r = 255; g = 255; b = 255;
+    }
+    else {
+      uint8_t desat = 255 - sat;
+      desat = scale8_video(desat, desat);
+      uint8_t satscale = 255 - desat;
+
+      r = scale8(r, satscale) + desat;
+      g = scale8(g, satscale) + desat;
+      b = scale8(b, satscale) + desat;
+    }
+  }
+
+  // and scale down towards black
+  if (val != 255) {
+    val = scale8_video(val, val);
+
+    if (val == 0) { r = 0; g = 0; b = 0; }
+    else { r = scale8(r, val); g = scale8(g, val); b = scale8(b, val); }
+  }
+
+  rgb.r = r;
+  rgb.g = g;
+  rgb.b = b;
+}
+
+void fill_solid(CRGB *leds, int numToFill, const CRGB &color) {
+  for (int i = 0; i < numToFill; ++i) leds[i] = color;
+}
+
+void fill_rainbow(CRGB *leds, int numToFill, uint8_t initialhue, uint8_t deltahue) {
+  CHSV hsv(initialhue, 240, 255);
+
+  for (int i = 0; i < numToFill; ++i) {
+    leds[i] = hsv;
+    hsv.hue += deltahue;
+  }
+}
+
+// the 8.7 fixed-point walk from FastLED's colorutils.h
+void fill_gradient(CRGB *leds, uint16_t numLeds, const CHSV &c1, const CHSV &c2, TGradientDirectionCode directionCode) {
+  if (numLeds == 0) return;
+
+  uint16_t endpos = numLeds - 1;
+  CHSV startcolor = c1;
+  CHSV endcolor = c2;
+
+  if (endcolor.val == 0 || endcolor.sat == 0) endcolor.hue = startcolor.hue;
+  if (startcolor.val == 0 || startcolor.sat == 0) startcolor.hue = endcolor.hue;
+
+  int16_t huedistance87;
+  int16_t satdistance87 = (endcolor.sat - startcolor.sat) << 7;
+  int16_t valdistance87 = (endcolor.val - startcolor.val) << 7;
+  uint8_t huedelta8 = endcolor.hue - startcolor.hue;
+
+  if (directionCode == SHORTEST_HUES) directionCode = huedelta8 > 127 ? BACKWARD_HUES : FORWARD_HUES;
+  if (directionCode == LONGEST_HUES) directionCode = huedelta8 < 128 ? BACKWARD_HUES : FORWARD_HUES;
+
+  if (directionCode == FORWARD_HUES) {
+    huedistance87 = huedelta8 << 7;
+  }
+  else {
+    huedistance87 = (uint8_t)(256 - huedelta8) << 7;
+    huedistance87 = -huedistance87;
+  }
+
+  int16_t divisor = endpos ? endpos : 1;
+  int16_t huedelta87 = (huedistance87 / divisor) * 2;
+  int16_t satdelta87 = (satdistance87 / divisor) * 2;
+  int16_t valdelta87 = (valdistance87 / divisor) * 2;
+
+  uint16_t hue88 = startcolor.hue << 8;
+  uint16_t sat88 = startcolor.sat << 8;
+  uint16_t val88 = startcolor.val << 8;
+
+  for (uint16_t i = 0; i <= endpos; ++i) {
+    leds[i] = CHSV(hue88 >> 8, sat88 >> 8, val88 >> 8);
+    hue88 += huedelta87;
+    sat88 += satdelta87;
+    val88 += valdelta87;
+  }
+}
+
+void nscale8(CRGB *leds, uint16_t numLeds, uint8_t scale) {
+  for (uint16_t i = 0; i < numLeds; ++i) leds[i].nscale8(scale);
+}
+
+void fadeToBlackBy(CRGB *leds, uint16_t numLeds, uint8_t fadeBy) {
+  nscale8(leds, numLeds, 255 - fadeBy);
+}
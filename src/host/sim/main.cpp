@@ -0,0 +1,300 @@
+/*
+ *  [env:sim] -- runs a whole mesh on the host and reports how long it takes to settle.
+ *
+ *    usage: program [--nodes=50] [--seconds=60] [--latency-ms=5] [--jitter-ms=2] [--loss=0] [--skew-ppm=50]
+ *                   [--tick-ms=2] [--join-spread-ms=2000] [--hue-tolerance=12] [--seed=1] [--trace=<node index>]
+ *                   [--record=<node index>] [--duplicate=0] [--mesh-time-start-s=0] [--command-at-s=<s>]
+ *                   [--command-lead-ms=500]
+ *
+ *  "Converged" means every node that's up agrees on the same (lowest ID) controller, exactly one node thinks it's the
+ *  controller, every node shows the controller's (connected) animation, and every gHue is within --hue-tolerance steps of the
+ *  controller's.  The default tolerance is the firmware's own dead band: a beacon leaves gHue alone when it's within
+ *  HUE_DEAD_BAND (12) steps of the controller's.  The time reported is when that last became true and stayed true until the end of
+ *  the run.  Exits non-zero if the mesh hasn't converged by the end.
+ *
+ *  It also reports hue phase error against the controller (sim/syncMetric.h) over the second half of the run.
+ *
+ *  --duplicate is the chance each delivered copy of a message arrives a second time, later.  The dedupe line counts
+ *  what the nodes' duplicate caches (dedupe.h) let through and dropped.
+ *
+ *  The latency line compares the nodes' round-trip estimates of the trip from the controller (latency.h) with the mean
+ *  the simulated links give it.
+ *
+ *  Built with -DSTREAM_FROM_CONTROLLER=true, the controller streams its frames (pixelStream.h) and a stream line
+ *  counts them.
+ *
+ *  --command-at-s has the controller schedule a switch to BANANA mode for every node (commands.h) at that time,
+ *  --command-lead-ms ahead, and a command line reports when the nodes switched, relative to the time it was for: how
+ *  close to the same frame they all made it, and how many then went back to another mode.  With a lead of 0, the
+ *  switch ripples out the way a mode change in a beacon does.
+ *
+ *  --mesh-time-start-s sets the mesh time the run starts at; 4294 puts the 32-bit wrap a few seconds in.
+ *
+ *  --record writes that node's mesh traffic to node<index>.trace, for the replay tool.  Only the node's first power-up
+ *  is recorded.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#include "simulator.h"
+#include "syncMetric.h"
+
+struct Convergence {
+  uint8_t hueTolerance = 12;
+  bool controllerOk = false;
+  bool hueOk = false;
+  uint64_t controllerSince = 0;       // start of the current good stretch
+  uint64_t hueSince = 0;
+  uint8_t hueSpread = 0;
+};
+
+static uint8_t hueDistance(uint8_t a, uint8_t b) {
+  uint8_t d = a - b;
+  return d > 128 ? 256 - d : d;
+}
+
+static void sample(Simulator &sim, Convergence &c) {
+  const SimNode *lowest = nullptr;
+  uint32_t controllers = 0;
+
+  for (const SimNode &node : sim.nodes) {
+    if (!node.up) continue;
+    if (!lowest || node.id < lowest->id) lowest = &node;
+    controllers += node.state.amController;
+  }
+
+  bool controllerOk = lowest && controllers == 1 && lowest->state.amController;
+  bool hueOk = controllerOk;
+  uint8_t spread = 0;
+
+  for (const SimNode &node : sim.nodes) {
+    if (!node.up || !lowest) continue;
+
+    if ((uint32_t)node.state.knownControllerID != lowest->id) controllerOk = hueOk = false;
+    if (node.state.displayMode == ALONE || node.state.displayMode != lowest->state.displayMode) hueOk = false;
+
+    uint8_t distance = hueDistance(node.state.gHue, lowest->state.gHue);
+    if (distance > spread) spread = distance;
+  }
+
+  if (spread > c.hueTolerance) hueOk = false;
+
+  if (controllerOk && !c.controllerOk) c.controllerSince = sim.now();
+  if (hueOk && !c.hueOk) c.hueSince = sim.now();
+  c.controllerOk = controllerOk;
+  c.hueOk = hueOk;
+  c.hueSpread = spread;
+}
+
+#define COMMAND_LATE_MS 10
+
+// the controller schedules a mode change, and every node's first frame in the new mode is noted
+struct CommandRun {
+  double atS = -1;
+  double leadMs = COMMAND_LEAD_MS;
+  bool sent = false;
+  uint64_t forUs = 0;                 // simulation time the command is for
+  std::vector<bool> switched;
+  std::vector<bool> reverted;
+  uint32_t count = 0;
+  uint32_t back = 0;                  // switched, then back to another mode while still connected
+  uint32_t late = 0;                  // more than COMMAND_LATE_MS after it
+  int64_t earliestUs = INT64_MAX;     // relative to forUs
+  int64_t latestUs = INT64_MIN;
+};
+
+// runs as the node, see Simulator::onTick
+static void tick(Simulator &sim, SimNode &node, CommandRun &c) {
+  if (!c.sent && amController == true && sim.now() >= c.atS * 1e6) {
+    c.sent = scheduleCommand(COMMAND_DISPLAY_MODE, BANANA, c.leadMs);
+    c.forUs = sim.now() + c.leadMs * 1000;
+  }
+
+  if (!c.sent) return;
+
+  if (c.switched[node.index]) {
+    if (displayMode != BANANA && displayMode != ALONE && !c.reverted[node.index]) {
+      c.reverted[node.index] = true;
+      c.back++;
+    }
+    return;
+  }
+
+  if (displayMode != BANANA) return;
+
+  int64_t late = (int64_t)(sim.now() - c.forUs);
+  c.switched[node.index] = true;
+  c.count++;
+  if (late > COMMAND_LATE_MS * 1000) c.late++;
+  if (late < c.earliestUs) c.earliestUs = late;
+  if (late > c.latestUs) c.latestUs = late;
+}
+
+static bool option(const char *arg, const char *name, double &value) {
+  size_t length = strlen(name);
+  if (strncmp(arg, name, length) != 0 || arg[length] != '=') return false;
+
+  value = atof(arg + length + 1);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  SimConfig config;
+  Convergence convergence;
+  CommandRun command;
+
+  for (int i = 1; i < argc; i++) {
+    double v;
+
+    if (option(argv[i], "--nodes", v)) config.nodes = v;
+    else if (option(argv[i], "--seconds", v)) config.seconds = v;
+    else if (option(argv[i], "--latency-ms", v)) config.latencyMs = v;
+    else if (option(argv[i], "--jitter-ms", v)) config.jitterMs = v;
+    else if (option(argv[i], "--loss", v)) config.loss = v;
+    else if (option(argv[i], "--skew-ppm", v)) config.skewPpm = v;
+    else if (option(argv[i], "--tick-ms", v)) config.tickUs = v * 1000;
+    else if (option(argv[i], "--join-spread-ms", v)) config.joinSpreadMs = v;
+    else if (option(argv[i], "--hue-tolerance", v)) convergence.hueTolerance = v;
+    else if (option(argv[i], "--seed", v)) config.seed = v;
+    else if (option(argv[i], "--trace", v)) config.traceNode = v;
+    else if (option(argv[i], "--record", v)) config.recordNode = v;
+    else if (option(argv[i], "--duplicate", v)) config.duplicateChance = v;
+    else if (option(argv[i], "--mesh-time-start-s", v)) config.meshTimeStartUs = v * 1000000;
+    else if (option(argv[i], "--command-at-s", v)) command.atS = v;
+    else if (option(argv[i], "--command-lead-ms", v)) command.leadMs = v;
+    else {
+      fprintf(stderr, "unknown option: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+
+  SyncMetric metric(config.seconds * 1000000ULL / 2);
+
+  Simulator sim(config);
+  sim.onSample = [&convergence, &metric](Simulator &s) { sample(s, convergence); metric.sample(s); };
+
+  if (command.atS >= 0) {
+    command.switched.resize(config.nodes);
+    command.reverted.resize(config.nodes);
+    sim.onTick = [&command](Simulator &s, SimNode &node) { tick(s, node, command); };
+  }
+
+#ifdef RECORD_TRACE
+  FILE *traceFile = nullptr;
+  FileTraceOutput traceOutput(nullptr);
+
+  if (config.recordNode >= 0 && (uint32_t)config.recordNode < config.nodes) {
+    char name[32];
+    snprintf(name, sizeof(name), "node%d.trace", config.recordNode);
+
+    traceFile = fopen(name, "wb");
+    if (!traceFile) {
+      fprintf(stderr, "can't write %s\n", name);
+      return 2;
+    }
+
+    traceOutput.file = traceFile;
+    traceBegin(&traceOutput, sim.nodes[config.recordNode].id);
+  }
+#endif
+
+  sim.run((uint64_t)config.seconds * 1000000);
+
+#ifdef RECORD_TRACE
+  if (traceFile) {
+    traceEnd();
+    fclose(traceFile);
+  }
+#endif
+
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  printf("meshLights sim: %u nodes, %u s, latency %.1f+%.1f ms/hop, loss %.1f%%/hop, skew +-%.0f ppm, seed %u\n",
+    config.nodes, config.seconds, config.latencyMs, config.jitterMs, config.loss * 100, config.skewPpm, config.seed);
+
+  if (convergence.controllerOk) printf(" . controller: converged at %.2f s\n", convergence.controllerSince / 1e6);
+  else printf(" . controller: NOT converged\n");
+
+  if (convergence.hueOk) printf(" . hue phase:  converged at %.2f s (spread %u steps)\n", convergence.hueSince / 1e6, convergence.hueSpread);
+  else printf(" . hue phase:  NOT converged (spread %u steps)\n", convergence.hueSpread);
+
+  printf(" . sync err:   mean %.2f, p50 %.2f, p99 %.2f, max %.2f hue steps (second half of the run)\n", metric.mean(),
+    metric.percentile(50), metric.percentile(99), metric.percentile(100));
+  printf(" . traffic:    %llu broadcasts, %llu unicasts, %llu deliveries, %llu dropped, %.2f MB on air\n",
+    (unsigned long long)sim.stats.broadcasts, (unsigned long long)sim.stats.unicasts, (unsigned long long)sim.stats.deliveries,
+    (unsigned long long)sim.stats.dropped, sim.stats.bytesOnAir / 1e6);
+  DedupeCounters dedupe = {};
+  for (const SimNode &node : sim.nodes) {
+    dedupe.accepted += node.state.seenMessages.counters.accepted;
+    dedupe.duplicates += node.state.seenMessages.counters.duplicates;
+    dedupe.stale += node.state.seenMessages.counters.stale;
+    dedupe.restarts += node.state.seenMessages.counters.restarts;
+  }
+
+  printf(" . dedupe:     %u accepted (%u after a sender restart), %u duplicates and %u stale dropped, %llu copies duplicated\n",
+    dedupe.accepted, dedupe.restarts, dedupe.duplicates, dedupe.stale, (unsigned long long)sim.stats.duplicated);
+  OutboxCounters outbox = {};
+  for (const SimNode &node : sim.nodes) {
+    for (const OutboxCounters &c : node.state.outbox.counters) {
+      outbox.sent += c.sent;
+      outbox.dropped += c.dropped;
+      outbox.failed += c.failed;
+    }
+  }
+
+  printf(" . outbox:     %u sent, %u dropped, %u refused by the mesh\n", outbox.sent, outbox.dropped, outbox.failed);
+  StreamCounters stream = {};
+  for (const SimNode &node : sim.nodes) {
+    const StreamCounters &c = node.state.pixelStream.counters;
+    stream.keyframes += c.keyframes;
+    stream.deltas += c.deltas;
+    stream.skipped += c.skipped;
+    stream.applied += c.applied;
+    stream.incomplete += c.incomplete;
+    stream.missingBase += c.missingBase;
+    stream.nacks += c.nacks;
+  }
+
+  if (stream.keyframes + stream.deltas > 0) {
+    printf(" . stream:     %u keyframes and %u deltas sent, %u skipped; %u frames shown, %u incomplete, %u missing their base, %u NACKs\n",
+      stream.keyframes, stream.deltas, stream.skipped, stream.applied, stream.incomplete, stream.missingBase, stream.nacks);
+  }
+
+  // what the nodes' round-trip estimates (latency.h) make of the trip from the controller, next to what the simulated
+  // links actually take on average
+  uint32_t probes = 0, pongs = 0, rejected = 0, estimated = 0;
+  double transit = 0, simulated = 0, perHop = 0;
+  int32_t controller = sim.indexOf(sim.nodes.empty() ? 0 : sim.nodes[0].state.knownControllerID);
+  for (const SimNode &node : sim.nodes) {
+    const LatencyEstimator &latency = node.state.controllerLatency;
+    probes += latency.probes;
+    pongs += latency.pongs;
+    rejected += latency.rejected;
+
+    if (!node.up || !latency.valid() || controller < 0 || (uint32_t)controller == node.index) continue;
+    estimated++;
+    transit += latency.transitUs() / 1000.0;
+    perHop += latency.perHopUs() / 1000.0;
+    simulated += sim.hops(node.index, controller) * (config.latencyMs + config.jitterMs / 2);
+  }
+
+  if (probes > 0) {
+    printf(" . latency:    %u pings, %u answered, %u outliers; %u nodes estimate %.2f ms from the controller (%.2f ms/hop), simulated %.2f ms\n",
+      probes, pongs, rejected, estimated, estimated ? transit / estimated : 0, estimated ? perHop / estimated : 0,
+      estimated ? simulated / estimated : 0);
+  }
+
+  if (command.sent) {
+    printf(" . command:    BANANA mode for %.2f s, %.0f ms ahead: %u of %u nodes switched, from %.2f to %.2f ms after it, %u over %u ms late, %u switched back\n",
+      command.forUs / 1e6, command.leadMs, command.count, sim.upCount(), command.earliestUs / 1e3, command.latestUs / 1e3,
+      command.late, COMMAND_LATE_MS, command.back);
+  }
+
+  printf(" . host:       %llu events in %.2f s wall (%.1fx real time)\n", (unsigned long long)sim.stats.events, wall, config.seconds / wall);
+
+  return convergence.controllerOk && convergence.hueOk ? 0 : 1;
+}
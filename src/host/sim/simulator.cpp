@@ -0,0 +1,418 @@
+#include "simulator.h"
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// WHAT THE CURRENT NODE SEES
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// the node's own oscillator, counting from its power-up
+uint32_t SimClock::millis() {
+  SimNode *node = sim->current;
+  return node ? (uint64_t)((sim->nowUs - node->bootUs) * node->rate) / 1000 : sim->nowUs / 1000;
+}
+
+uint32_t SimClock::micros() {
+  SimNode *node = sim->current;
+  return node ? (uint64_t)((sim->nowUs - node->bootUs) * node->rate) : sim->nowUs;
+}
+
+uint32_t SimTransport::getNodeId() {
+  return sim->current->id;
+}
+
+uint32_t SimTransport::getNodeTime() {
+  return sim->meshTime(*sim->current);
+}
+
+SimpleList<uint32_t> SimTransport::getNodeList() {
+  SimpleList<uint32_t> list;
+
+  SimNode *current = sim->current;
+
+  for (SimNode &node : sim->nodes) {
+    if (node.up && &node != current && node.root == current->root) list.push_back(node.id);
+  }
+
+  if (sim->nowUs < current->orphanUntilUs) list.push_back(0);
+  return list;
+}
+
+uint8_t SimTransport::hopsTo(uint32_t nodeId) {
+  int32_t index = sim->indexOf(nodeId);
+  SimNode *current = sim->current;
+
+  if (index < 0 || !sim->nodes[index].up || sim->nodes[index].root != current->root) return 0;
+  uint32_t hops = sim->hops(current->index, index);
+  return hops < 255 ? hops : 255;
+}
+
+bool SimTransport::sendBroadcast(String &msg) {
+  SimNode &from = *sim->current;
+  std::shared_ptr<String> shared = std::make_shared<String>(msg);
+
+  sim->stats.broadcasts++;
+  sim->stats.bytesOnAir += (uint64_t)msg.length() * (sim->treeSize(from.index) - 1);   // a flood crosses every tree edge once
+
+  for (SimNode &to : sim->nodes) {
+    if (to.up && &to != &from && to.root == from.root) sim->deliver(from, to, shared);
+  }
+
+  return true;
+}
+
+bool SimTransport::sendSingle(uint32_t dest, String &msg) {
+  int32_t index = sim->indexOf(dest);
+  SimNode &from = *sim->current;
+  if (index < 0 || !sim->nodes[index].up || sim->nodes[index].root != from.root) return false;
+
+  std::shared_ptr<String> shared = std::make_shared<String>(msg);
+
+  sim->stats.unicasts++;
+  sim->stats.bytesOnAir += (uint64_t)msg.length() * sim->hops(from.index, index);
+  sim->deliver(from, sim->nodes[index], shared);
+  return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// SIMULATOR
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+Simulator::Simulator(const SimConfig &config) :
+  config(config), stats(), rng(config.seed), eventSeq(0), nowUs(0), current(nullptr), clock(this), transport(this) {
+
+  localClock = &clock;
+  meshTransport = &transport;
+  ledSink = &sink;
+
+  randomSeed(config.seed);
+  random16_set_seed(config.seed);
+  Serial.setOutput(nullptr);
+
+  std::uniform_real_distribution<double> skew(-config.skewPpm, config.skewPpm);
+  std::uniform_int_distribution<uint32_t> boot(0, config.joinSpreadMs * 1000);
+
+  nodes.resize(config.nodes);
+
+  for (uint32_t i = 0; i < config.nodes; i++) {
+    SimNode &node = nodes[i];
+
+    // painlessMesh IDs come from the MAC address; random and unique is close enough
+    do { node.id = rng(); } while (node.id == 0 || idToIndex.count(node.id));
+    idToIndex[node.id] = i;
+
+    node.index = i;
+    node.up = false;
+    node.generation = 0;
+    node.parent = -1;
+    node.depth = 0;
+    node.root = i;
+    node.orphanUntilUs = 0;
+    node.rate = 1.0 + skew(rng) / 1e6;
+    node.bootUs = 0;
+    node.meshErrorUs = 0;
+    node.lastSyncUs = 0;
+
+    joinAt(boot(rng), i);
+  }
+
+  push(0, SIM_SAMPLE, 0);
+}
+
+void Simulator::joinAt(uint64_t us, uint32_t index) { push(us, SIM_JOIN, index); }
+void Simulator::leaveAt(uint64_t us, uint32_t index) { push(us, SIM_LEAVE, index); }
+
+void Simulator::push(uint64_t at, SimEventType type, uint32_t node, uint32_t from, std::shared_ptr<String> msg) {
+  SimEvent event;
+  event.at = at;
+  event.seq = eventSeq++;
+  event.type = type;
+  event.node = node;
+  event.from = from;
+  event.msg = msg;
+  events.push(event);
+}
+
+int32_t Simulator::indexOf(uint32_t id) const {
+  std::unordered_map<uint32_t, uint32_t>::const_iterator found = idToIndex.find(id);
+  return found == idToIndex.end() ? -1 : (int32_t)found->second;
+}
+
+uint32_t Simulator::upCount() const {
+  uint32_t count = 0;
+  for (const SimNode &node : nodes) count += node.up;
+  return count;
+}
+
+uint32_t Simulator::treeSize(uint32_t index) const {
+  uint32_t count = 0;
+  for (const SimNode &node : nodes) count += node.up && node.root == nodes[index].root;
+  return count;
+}
+
+uint64_t Simulator::meshTime(const SimNode &node) const {
+  int64_t drift = (int64_t)((node.rate - 1.0) * (double)(nowUs - node.lastSyncUs));
+  return config.meshTimeStartUs + nowUs + node.meshErrorUs + drift;
+}
+
+// tree distance: walk the deeper node up until both meet
+uint32_t Simulator::hops(uint32_t a, uint32_t b) const {
+  uint32_t count = 0;
+
+  while (a != b) {
+    if (nodes[a].depth >= nodes[b].depth && nodes[a].parent >= 0) a = nodes[a].parent;
+    else if (nodes[b].parent >= 0) b = nodes[b].parent;
+    else break;                       // different trees, shouldn't happen
+    count++;
+  }
+
+  return count;
+}
+
+uint64_t Simulator::transitUs(uint32_t hopCount) {
+  std::uniform_real_distribution<double> jitter(0, config.jitterMs * 1000);
+  double us = 0;
+
+  for (uint32_t i = 0; i < hopCount; i++) us += config.latencyMs * 1000 + jitter(rng);
+  return (uint64_t)us;
+}
+
+// each copy of a message is lost (or not) independently, with the loss compounding over its hops
+bool Simulator::lost(uint32_t hopCount) {
+  if (config.loss <= 0) return false;
+
+  std::uniform_real_distribution<double> chance(0, 1);
+  for (uint32_t i = 0; i < hopCount; i++) if (chance(rng) < config.loss) return true;
+  return false;
+}
+
+void Simulator::deliver(SimNode &from, SimNode &to, std::shared_ptr<String> &msg) {
+  uint32_t hopCount = hops(from.index, to.index);
+
+  if (lost(hopCount)) {
+    stats.dropped++;
+    return;
+  }
+
+  uint64_t at = nowUs + transitUs(hopCount);
+  push(at, SIM_DELIVER, to.index, from.id, msg);
+
+  // the second copy comes the long way round, so it can land after later messages too
+  std::uniform_real_distribution<double> chance(0, 1);
+  if (config.duplicateChance > 0 && chance(rng) < config.duplicateChance) {
+    stats.duplicated++;
+    push(at + transitUs(hopCount + 1), SIM_DELIVER, to.index, from.id, msg);
+  }
+}
+
+void Simulator::enter(SimNode &node) {
+  loadNodeState(node.state);
+  current = &node;
+  Serial.setOutput(config.traceNode == (int32_t)node.index ? stdout : nullptr);
+#ifdef RECORD_TRACE
+  traceSetActive(config.recordNode == (int32_t)node.index);
+#endif
+}
+
+void Simulator::leave() {
+  saveNodeState(current->state);
+  current = nullptr;
+  Serial.setOutput(nullptr);
+}
+
+// hang a node (and whatever hangs off it) off a random node that's up in some other tree, or leave it a root
+void Simulator::attach(SimNode &node) {
+  std::vector<uint32_t> candidates;
+  for (SimNode &other : nodes) if (other.up && other.root != node.root) candidates.push_back(other.index);
+
+  if (candidates.empty()) {
+    node.parent = -1;
+  }
+  else {
+    std::uniform_int_distribution<size_t> pick(0, candidates.size() - 1);
+    node.parent = candidates[pick(rng)];
+  }
+}
+
+// children of a departing node reconnect to its parent, or elect a new root among themselves.  With reconnectMs set
+// they're cut off instead, and each goes looking for the mesh again later.
+void Simulator::detach(SimNode &node) {
+  int32_t newRoot = -1;
+
+  for (SimNode &child : nodes) {
+    if (child.parent != (int32_t)node.index) continue;
+
+    if (config.reconnectMs > 0) {
+      child.parent = -1;
+      push(nowUs + config.reconnectMs * 1000ULL, SIM_RECONNECT, child.index, child.generation);
+    }
+    else if (node.parent >= 0) {
+      child.parent = node.parent;
+    }
+    else if (newRoot < 0) {
+      child.parent = -1;
+      newRoot = child.index;
+    }
+    else {
+      child.parent = newRoot;
+    }
+  }
+
+  node.parent = -1;
+}
+
+void Simulator::updateTrees() {
+  for (SimNode &node : nodes) {
+    uint32_t depth = 0;
+    uint32_t root = node.index;
+
+    for (int32_t at = node.parent; at >= 0; at = nodes[at].parent) {
+      depth++;
+      root = at;
+    }
+
+    node.depth = depth;
+    node.root = root;
+  }
+}
+
+// every node that's up in the same tree hears about a topology change once the news has travelled to it.  Now and
+// then the news leaves a ghost node ID 0 behind in someone's list.
+void Simulator::topologyChanged(uint32_t around) {
+  std::uniform_real_distribution<double> chance(0, 1);
+
+  stats.topologyChanges++;
+  stats.lastTopologyChangeUs = nowUs;
+
+  for (SimNode &node : nodes) {
+    if (!node.up || node.root != nodes[around].root) continue;
+
+    push(nowUs + transitUs(hops(around, node.index)), SIM_CHANGED, node.index);
+    if (config.orphanChance > 0 && chance(rng) < config.orphanChance) node.orphanUntilUs = nowUs + config.orphanMs * 1000ULL;
+  }
+}
+
+// painlessMesh re-syncing this node's time: the accumulated error is replaced with a small fresh one
+void Simulator::timeSync(SimNode &node) {
+  std::uniform_int_distribution<int32_t> residual(-(int32_t)config.meshSyncErrorUs, config.meshSyncErrorUs);
+  int64_t before = meshTime(node);
+
+  node.meshErrorUs = residual(rng);
+  node.lastSyncUs = nowUs;
+
+  enter(node);
+  nodeTimeAdjustedCallback((int32_t)(meshTime(node) - before));
+  leave();
+}
+
+void Simulator::run(uint64_t untilUs) {
+  while (!events.empty() && events.top().at <= untilUs) {
+    SimEvent event = events.top();
+    events.pop();
+
+    nowUs = event.at;
+    stats.events++;
+    SimNode &node = nodes[event.node];
+
+    switch (event.type) {
+      case SIM_TICK:
+        if (!node.up || event.from != node.generation) break;
+
+        enter(node);
+        stepLoop();
+        if (onTick) onTick(*this, node);
+        leave();
+
+        push(nowUs + config.tickUs, SIM_TICK, node.index, node.generation);
+      break;
+
+      case SIM_DELIVER:
+        if (!node.up) break;
+
+        stats.deliveries++;
+        enter(node);
+        receivedCallback(event.from, *event.msg);
+        leave();
+      break;
+
+      case SIM_CHANGED:
+        if (!node.up) break;
+
+        enter(node);
+        changedConnectionCallback();
+        leave();
+      break;
+
+      case SIM_JOIN: {
+        if (node.up) break;
+
+        std::uniform_int_distribution<int32_t> residual(-(int32_t)config.meshSyncErrorUs, config.meshSyncErrorUs);
+        std::uniform_int_distribution<uint32_t> syncPhase(0, config.timeSyncSeconds * 1000000);
+
+        node.up = true;
+        node.generation++;
+        node.bootUs = nowUs;
+        node.meshErrorUs = residual(rng);
+        node.lastSyncUs = nowUs;
+
+        enter(node);
+        resetNodeState();
+        leave();
+
+        node.root = node.index;
+        attach(node);
+        updateTrees();
+        topologyChanged(node.index);
+
+        push(nowUs + config.tickUs, SIM_TICK, node.index, node.generation);
+        push(nowUs + syncPhase(rng), SIM_TIME_SYNC, node.index, node.generation);
+      }
+      break;
+
+      case SIM_LEAVE: {
+        if (!node.up) break;
+
+        int32_t neighbour = node.parent;
+        std::vector<uint32_t> islands;
+
+        for (SimNode &child : nodes) if (child.parent == (int32_t)node.index) islands.push_back(child.index);
+
+        node.up = false;
+        detach(node);
+        updateTrees();
+
+        // the news starts from wherever the node was hanging off
+        if (neighbour < 0) {
+          for (SimNode &other : nodes) if (other.up) { neighbour = other.index; break; }
+        }
+        if (neighbour >= 0) topologyChanged(neighbour);
+
+        // and any subtree that's been cut off finds out it's on its own
+        for (uint32_t island : islands) {
+          if (nodes[island].root == island && (neighbour < 0 || nodes[neighbour].root != island)) topologyChanged(island);
+        }
+      }
+      break;
+
+      case SIM_RECONNECT:
+        if (!node.up || event.from != node.generation || node.parent >= 0) break;
+
+        attach(node);
+        updateTrees();
+        topologyChanged(node.index);
+      break;
+
+      case SIM_TIME_SYNC:
+        if (!node.up || event.from != node.generation) break;
+
+        timeSync(node);
+        push(nowUs + config.timeSyncSeconds * 1000000ULL, SIM_TIME_SYNC, node.index, node.generation);
+      break;
+
+      case SIM_SAMPLE:
+        if (onSample) onSample(*this);
+        push(nowUs + config.sampleMs * 1000, SIM_SAMPLE, 0);
+      break;
+    }
+  }
+
+  nowUs = untilUs;
+}
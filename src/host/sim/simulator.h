@@ -0,0 +1,183 @@
+/*
+ *  Discrete-event mesh simulator.
+ *
+ *  Runs N virtual nodes in one process.  Every node has its own NodeState (the globals from meshLights.cpp), its own
+ *  oscillator and its own view of mesh time; the simulator swaps a node's state in, calls into the real logic
+ *  (stepLoop, receivedCallback, ...) and swaps it back out.  Broadcasts travel over a random spanning tree, the same
+ *  shape painlessMesh builds, with per-hop latency, jitter and loss, and optionally duplicated copies, the way a flood
+ *  over a denser mesh delivers some messages twice.
+ *
+ *  When a node drops out, its children either re-attach at once (the default) or, with reconnectMs set, are cut off
+ *  as islands of their own until they find the mesh again.  Nodes only see and reach nodes in the same tree.
+ */
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "meshLights.h"
+#include "host/hal_host.h"
+
+struct SimConfig {
+  uint32_t nodes = 50;
+  uint32_t seconds = 60;
+  uint32_t seed = 1;
+  double latencyMs = 5;               // per hop
+  double jitterMs = 2;                // per hop, uniformly 0..jitter on top of latency
+  double loss = 0;                    // per hop, 0..1
+  double skewPpm = 50;                // each oscillator runs fast or slow by up to this much
+  uint32_t meshSyncErrorUs = 500;     // how far off painlessMesh's time sync leaves a node
+  uint32_t timeSyncSeconds = 60;      // how often painlessMesh re-syncs a node's time
+  uint32_t tickUs = 2000;             // loop() period
+  uint32_t joinSpreadMs = 2000;       // nodes power up at random over this window
+  uint32_t sampleMs = 100;            // how often onSample() is called
+  int32_t traceNode = -1;             // index of the node whose Serial output is shown, -1 for none
+  int32_t recordNode = -1;            // index of the node whose mesh traffic is recorded (RECORD_TRACE builds), -1 for none
+  uint32_t reconnectMs = 0;           // how long the children of a departed node are cut off, 0 to re-attach at once
+  double orphanChance = 0;            // chance a connection change leaves a ghost node ID 0 in a node's list, 0..1
+  uint32_t orphanMs = 1000;           // and for how long
+  double duplicateChance = 0;         // chance a delivered copy arrives a second time, over another path, 0..1
+  uint64_t meshTimeStartUs = 0;       // mesh time when the run starts, to put a 32-bit wrap inside it
+};
+
+struct SimNode {
+  uint32_t id;
+  uint32_t index;
+  bool up;
+  uint32_t generation;                // bumped on every power-up, so a stale tick chain can tell it's stale
+  int32_t parent;                     // spanning tree, -1 for the root
+  uint32_t depth;
+  uint32_t root;                      // index of the root of this node's tree; nodes in other trees can't be reached
+  uint64_t orphanUntilUs;             // getNodeList() includes a bogus 0 until then
+
+  double rate;                        // local oscillator speed, 1.0 = perfect
+  uint64_t bootUs;                    // simulation time it powered up
+  int64_t meshErrorUs;                // mesh time minus true time, as of lastSyncUs
+  uint64_t lastSyncUs;
+
+  NodeState state;
+};
+
+struct SimStats {
+  uint64_t broadcasts;
+  uint64_t unicasts;
+  uint64_t deliveries;
+  uint64_t dropped;
+  uint64_t duplicated;                // extra copies delivered, see duplicateChance
+  uint64_t bytesOnAir;                // every hop of every copy
+  uint64_t events;
+  uint64_t topologyChanges;           // joins, leaves and reconnects
+  uint64_t lastTopologyChangeUs;
+};
+
+enum SimEventType { SIM_TICK, SIM_DELIVER, SIM_CHANGED, SIM_JOIN, SIM_LEAVE, SIM_TIME_SYNC, SIM_RECONNECT, SIM_SAMPLE };
+
+struct SimEvent {
+  uint64_t at;
+  uint64_t seq;
+  SimEventType type;
+  uint32_t node;
+  uint32_t from;
+  std::shared_ptr<String> msg;
+
+  bool operator > (const SimEvent &rhs) const { return at != rhs.at ? at > rhs.at : seq > rhs.seq; }
+};
+
+class Simulator;
+
+// what the logic sees as its clock and its mesh, for whichever node is currently swapped in
+class SimClock : public Clock {
+public:
+  SimClock(Simulator *sim) : sim(sim) {}
+  uint32_t millis();
+  uint32_t micros();
+
+private:
+  Simulator *sim;
+};
+
+class SimTransport : public MeshTransport {
+public:
+  SimTransport(Simulator *sim) : sim(sim) {}
+
+  void update() {}
+  uint32_t getNodeId();
+  uint32_t getNodeTime();
+  SimpleList<uint32_t> getNodeList();
+  bool sendBroadcast(String &msg);
+  bool sendSingle(uint32_t dest, String &msg);
+  String subConnectionJson() { return String("[]"); }
+  uint8_t hopsTo(uint32_t nodeId);
+
+  int32_t rssi() { return -50; }
+  String localIP() { return String("10.0.0.1"); }
+  const char* linkMode() { return "SIM"; }
+  const char* linkStatus() { return "CONNECTED"; }
+
+private:
+  Simulator *sim;
+};
+
+class Simulator {
+public:
+  Simulator(const SimConfig &config);
+
+  // schedule topology changes; the constructor already schedules every node's power-up within joinSpreadMs
+  void joinAt(uint64_t us, uint32_t index);
+  void leaveAt(uint64_t us, uint32_t index);
+
+  // process events up to (and including) the given time.  Only one Simulator can run at a time: it owns the HAL pointers.
+  void run(uint64_t untilUs);
+
+  uint64_t now() const { return nowUs; }
+  uint32_t hops(uint32_t a, uint32_t b) const;
+  int32_t indexOf(uint32_t id) const;
+  uint32_t upCount() const;
+  uint32_t treeSize(uint32_t index) const;       // nodes that are up in the same tree, including this one
+  uint64_t meshTime(const SimNode &node) const;
+
+  // called every sampleMs of simulated time, with no node swapped in
+  std::function<void(Simulator &)> onSample;
+
+  // called after every stepLoop(), with the node still swapped in, so it can call into the logic as that node
+  std::function<void(Simulator &, SimNode &)> onTick;
+
+  SimConfig config;
+  std::vector<SimNode> nodes;
+  SimStats stats;
+  std::mt19937 rng;
+
+private:
+  friend class SimClock;
+  friend class SimTransport;
+
+  void push(uint64_t at, SimEventType type, uint32_t node, uint32_t from = 0, std::shared_ptr<String> msg = nullptr);
+  void enter(SimNode &node);
+  void leave();
+  void attach(SimNode &node);
+  void detach(SimNode &node);
+  void updateTrees();
+  void topologyChanged(uint32_t around);
+  void timeSync(SimNode &node);
+  uint64_t transitUs(uint32_t hopCount);
+  bool lost(uint32_t hopCount);
+  void deliver(SimNode &from, SimNode &to, std::shared_ptr<String> &msg);
+
+  std::priority_queue<SimEvent, std::vector<SimEvent>, std::greater<SimEvent> > events;
+  uint64_t eventSeq;
+  uint64_t nowUs;
+  SimNode *current;
+  std::unordered_map<uint32_t, uint32_t> idToIndex;
+
+  SimClock clock;
+  SimTransport transport;
+  NullLedSink sink;
+};
+
+#endif
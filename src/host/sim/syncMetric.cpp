@@ -0,0 +1,64 @@
+#include <algorithm>
+#include <math.h>
+
+#include "syncMetric.h"
+
+// painlessMesh's mesh time plus the node's own drift correction (see drift.h), as meshTime() works it out
+static double nodeMeshTime(const Simulator &sim, const SimNode &node) {
+  uint32_t localMs = (uint64_t)((sim.now() - node.bootUs) * node.rate) / 1000;
+  return (double)sim.meshTime(node) + (double)node.state.clockDrift.correction(localMs);
+}
+
+double phaseError(const Simulator &sim, const SimNode &node, const SimNode &controller) {
+  double clockSteps = (nodeMeshTime(sim, node) - nodeMeshTime(sim, controller)) / (HUE_DELAY * 1000.0);
+  double error = fmod(node.state.gHue - controller.state.gHue - clockSteps, 256.0);
+
+  if (error >= 128) error -= 256;
+  if (error < -128) error += 256;
+  return error;
+}
+
+void SyncMetric::sample(Simulator &sim) {
+  if (sim.now() < warmupUs) return;
+
+  const SimNode *controller = nullptr;
+  uint32_t controllers = 0;
+
+  for (const SimNode &node : sim.nodes) {
+    if (!node.up) continue;
+    if (!controller || node.id < controller->id) controller = &node;
+    controllers += node.state.amController;
+  }
+
+  samples++;
+
+  if (!controller || controllers != 1 || !controller->state.amController) {
+    leaderlessSamples++;
+    return;
+  }
+
+  for (const SimNode &node : sim.nodes) {
+    if (node.up && &node != controller) errors.push_back(fabs(phaseError(sim, node, *controller)));
+  }
+
+  sorted = false;
+}
+
+// nearest rank
+double SyncMetric::percentile(double percent) {
+  if (errors.empty()) return 0;
+
+  if (!sorted) {
+    std::sort(errors.begin(), errors.end());
+    sorted = true;
+  }
+
+  size_t rank = (size_t)ceil(percent / 100 * errors.size());
+  return errors[rank > 0 ? rank - 1 : 0];
+}
+
+double SyncMetric::mean() const {
+  double sum = 0;
+  for (double e : errors) sum += e;
+  return errors.empty() ? 0 : sum / errors.size();
+}
@@ -0,0 +1,41 @@
+/*
+ *  Hue phase error, sampled from a running Simulator.
+ *
+ *  On every sample, each node that's up is compared with the elected controller (the lowest ID that's up, if it thinks
+ *  it's the controller): the error is the node's gHue minus the hue the controller shows at the node's own mesh time,
+ *  in hue steps, wrapped to -128..127.  The controller's hue is shifted by the difference in the two nodes' mesh clocks
+ *  (one step per HUE_DELAY), so a node that's perfectly locked to the mesh time it was given scores zero.  That's the
+ *  mesh time meshTime() returns, drift correction included, not painlessMesh's alone.
+ */
+
+#ifndef SYNCMETRIC_H
+#define SYNCMETRIC_H
+
+#include <vector>
+
+#include "simulator.h"
+
+class SyncMetric {
+public:
+  SyncMetric(uint64_t warmupUs = 0) : warmupUs(warmupUs), leaderlessSamples(0), samples(0) {}
+
+  void sample(Simulator &sim);
+
+  // of |error|, over every node and every sample taken after the warm-up
+  double percentile(double percent);
+  double mean() const;
+  size_t count() const { return errors.size(); }
+
+  uint64_t warmupUs;                  // samples before this are ignored, so the mesh has time to form
+  uint32_t leaderlessSamples;         // samples with no single controller to measure against
+  uint32_t samples;
+
+private:
+  std::vector<double> errors;
+  bool sorted = true;
+};
+
+// signed error of one node against the controller, in hue steps
+double phaseError(const Simulator &sim, const SimNode &node, const SimNode &controller);
+
+#endif
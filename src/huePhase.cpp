@@ -0,0 +1,25 @@
+/*
+ *  The rainbow's phase, finer than a hue step, see huePhase.h.
+ */
+
+#include "huePhase.h"
+
+void HuePhase::reset(uint32_t newRate, uint32_t nowUs) {
+  phase = 0;
+  rate = newRate;
+  lastUs = nowUs;
+  remainder = 0;
+}
+
+void HuePhase::advance(uint32_t nowUs) {
+  uint64_t moved = (uint64_t)(uint32_t)(nowUs - lastUs) * rate + remainder;
+
+  phase += (uint32_t)(moved >> 8);
+  remainder = moved & 0xFF;
+  lastUs = nowUs;
+}
+
+void HuePhase::shift(int32_t us) {
+  if (us >= 0) phase += span(us);
+  else phase -= span(-(int64_t)us);
+}
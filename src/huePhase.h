@@ -0,0 +1,41 @@
+/*
+ *  The rainbow's phase, finer than a hue step.
+ *
+ *  gHue used to be a counter stepped once every HUE_DELAY ms by a timer, and every correction to it was in whole steps.
+ *  HuePhase keeps it as the top 8 bits of a 32-bit phase instead, so one hue step is HUE_PHASE_STEP (2^24) units.
+ *  advance() moves the phase on by the microseconds since the last call times the rate: a frame that's late draws the
+ *  hue it's late for, however uneven the frames are, and a correction (see set()) can land anywhere within a step.
+ *
+ *  The rate is phase units per microsecond in 256ths, rounded to the nearest, so a step every 12 ms (HUE_DELAY) runs
+ *  0.16 parts per million fast: a hue step ahead every 20 hours or so, for a node that never resyncs.
+ *  Changing it changes the speed from the next advance() on, without a jump.
+ */
+
+#ifndef HUEPHASE_H
+#define HUEPHASE_H
+
+#include <stdint.h>
+
+#define HUE_PHASE_STEP            ((uint32_t)1 << 24)
+#define HUE_PHASE_RATE(stepUs)    ((uint32_t)((((uint64_t)HUE_PHASE_STEP << 8) + (stepUs) / 2) / (stepUs)))   // for a step every stepUs
+
+class HuePhase {
+public:
+  HuePhase(uint32_t rate = 0) { reset(rate, 0); }
+  void reset(uint32_t rate, uint32_t nowUs);    // back to phase 0
+
+  void advance(uint32_t nowUs);           // on by the time since the last advance() or set()
+  void set(uint32_t newPhase, uint32_t nowUs) { phase = newPhase; lastUs = nowUs; }
+  void shift(int32_t us);                 // forward (or back) by that long's worth, for the drift compensation
+
+  uint32_t span(uint64_t us) const { return (us * rate) >> 8; }   // how far the phase moves in that long
+  uint32_t at(uint32_t nowUs) const { return phase + (((uint64_t)(uint32_t)(nowUs - lastUs) * rate + remainder) >> 8); }   // what advance() would make it
+  uint8_t hue() const { return phase >> 24; }
+
+  uint32_t phase;
+  uint32_t rate;                          // phase units per microsecond, in 256ths
+  uint32_t lastUs;                        // micros() of the last advance() or set()
+  uint8_t remainder;                      // the 256ths advance() couldn't add yet
+};
+
+#endif
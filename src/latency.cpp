@@ -0,0 +1,106 @@
+/*
+ *  Round-trip latency to the controller, see latency.h.
+ */
+
+#include "latency.h"
+
+void LatencyEstimator::reset(uint32_t nowMs, uint8_t newJitter) {
+  srttUs = 0;
+  rttvarUs = 0;
+  hops = 0;
+  samples = 0;
+  outliers = 0;
+  waiting = false;
+  probe = 0;
+  lastProbeMs = nowMs;
+  jitter = newJitter;
+}
+
+bool LatencyEstimator::probeDue(uint32_t nowMs) const {
+  uint32_t delay = samples < LATENCY_MIN_SAMPLES ? PROBE_FAST_MS : PROBE_DELAY_MS;
+
+  return nowMs - lastProbeMs >= delay / 2 + (delay * jitter >> 8);
+}
+
+void LatencyEstimator::probeSent(uint32_t sentUs, uint32_t nowMs, uint8_t newJitter) {
+  waiting = true;                         // a ping that never got an answer is forgotten, it's this one we wait for
+  probe = sentUs;
+  lastProbeMs = nowMs;
+  jitter = newJitter;
+  probes++;
+}
+
+// how far over the average a round trip can be before it's an outlier
+static int32_t rttSpread(int32_t rttvarUs) {
+  int32_t spread = LATENCY_SPREAD * rttvarUs;
+  return spread > LATENCY_MIN_SPREAD_US ? spread : LATENCY_MIN_SPREAD_US;
+}
+
+bool LatencyEstimator::pong(uint32_t sentUs, uint32_t nowUs, uint8_t newHops) {
+  if (!waiting || sentUs != probe) return false;
+
+  int32_t rtt = nowUs - sentUs;
+  waiting = false;
+  pongs++;
+
+  if (samples >= LATENCY_MIN_SAMPLES && rtt > srttUs + rttSpread(rttvarUs)) {
+    if (++outliers < LATENCY_PATH_CHANGE) {
+      rejected++;
+      return true;
+    }
+
+    samples = 0;                          // not a fluke any more: start over from this one
+  }
+
+  outliers = 0;
+  hops = newHops;
+
+  // RFC 6298's smoothing: the average moves an eighth of the way, the deviation a quarter
+  if (samples == 0) {
+    srttUs = rtt;
+    rttvarUs = rtt / 2;
+  }
+  else {
+    int32_t error = rtt - srttUs;
+    srttUs += error / 8;
+    rttvarUs += ((error < 0 ? -error : error) - rttvarUs) / 4;
+  }
+
+  if (samples < UINT16_MAX) samples++;
+  return true;
+}
+
+void LatencyEstimator::hopsChanged(uint8_t newHops) {
+  if (!valid() || hops == 0 || newHops == 0 || newHops == hops) return;
+
+  // scale to the new path, and ping quickly again to find out how right that was
+  srttUs = (int64_t)srttUs * newHops / hops;
+  rttvarUs = (int64_t)rttvarUs * newHops / hops;
+  hops = newHops;
+  samples = 1;
+}
+
+uint32_t LatencyEstimator::spreadUs() const {
+  return rttSpread(rttvarUs) / 2;
+}
+
+uint32_t LatencyEstimator::maxAgeUs(uint32_t fallbackUs) const {
+  if (!valid()) return fallbackUs;
+
+  // a whole round trip and its spread: a message older than that by its timestamp has sat in a queue somewhere, or
+  // the clocks disagree by more than a trip takes, and either way what it says about the phase can't be trusted
+  uint32_t age = srttUs + rttSpread(rttvarUs);
+  if (age < LATENCY_MIN_AGE_US) return LATENCY_MIN_AGE_US;
+  return age < fallbackUs ? age : fallbackUs;
+}
+
+uint64_t LatencyEstimator::ageUs(uint64_t timestampAgeUs) const {
+  // older than any trip should take: held up on the way, so clamped to one trip it would set the hue that far behind
+  if (!valid() || timestampAgeUs > maxAgeUs(UINT32_MAX)) return timestampAgeUs;
+
+  uint64_t lowest = transitUs() > spreadUs() ? transitUs() - spreadUs() : 0;
+  uint64_t highest = transitUs() + spreadUs();
+
+  if (timestampAgeUs < lowest) return lowest;
+  return timestampAgeUs > highest ? highest : timestampAgeUs;
+}
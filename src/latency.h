@@ -0,0 +1,73 @@
+/*
+ *  Round-trip latency to the controller.
+ *
+ *  Every message carries the sender's mesh time, so a receiver can tell how long it's been on the way -- but only as
+ *  well as painlessMesh has synced the two clocks, and a few milliseconds off is a visible step in the rainbow.  So
+ *  every node but the controller pings it now and then (MSG_PING, answered with MSG_PONG), timing the round trip on
+ *  its own clock, where time sync doesn't come into it.  (The controller answers from its outbox, so a round trip also
+ *  has up to one pass of the controller's loop in it.)  The round trips are smoothed the way TCP smooths them (a
+ *  moving average and a moving mean deviation), and one that's far over the average is taken to be a retry or a queue
+ *  somewhere and left out, unless LATENCY_PATH_CHANGE of them come in a row: then the path has changed and the
+ *  estimate starts over from there.
+ *
+ *  Half the round trip is what a message from the controller should take to get here, give or take spreadUs().
+ *  ageUs() clamps the age worked out from a message's timestamp into that window before the hue is corrected by it,
+ *  unless it's past maxAgeUs(): a beacon that old was held up on the way (a retry, a queue), and its timestamp is the
+ *  better guess.  maxAgeUs() (a round trip and then some) also replaces a fixed MAX_MESSAGE_AGE as the point past
+ *  which a keyframe is too old to act on.  Until the first pong comes back, neither changes anything.
+ *
+ *  The hop count to the controller (from the mesh, see MeshTransport::hopsTo()) gives the delay per hop, and when the
+ *  mesh reshapes and the hop count changes, the estimate is scaled to the new count until new pings confirm it.
+ *
+ *  Pings go out every PROBE_FAST_MS until there's an estimate, then every PROBE_DELAY_MS, each wait stretched or
+ *  shrunk by up to half at random: every node starts over when the controller changes, and waits all the same length
+ *  would have them ping it together, again and again.  Pings and pongs go out as PRIORITY_TELEMETRY, behind anything
+ *  the nodes need to stay in step.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+
+#define PROBE_FAST_MS            1000     // num milliseconds between pings until there are LATENCY_MIN_SAMPLES round trips
+#define PROBE_DELAY_MS           10000    // and after
+#define LATENCY_MIN_SAMPLES      4
+#define LATENCY_SPREAD           4        // a round trip more than this many mean deviations over the average is an outlier
+#define LATENCY_MIN_SPREAD_US    4000     // but one this close to it never is
+#define LATENCY_PATH_CHANGE      3        // this many outliers in a row and the path has changed
+#define LATENCY_MIN_AGE_US       20000    // maxAgeUs() never goes below this, for painlessMesh's own time sync error
+
+class LatencyEstimator {
+public:
+  LatencyEstimator() : probes(0), pongs(0), rejected(0) { reset(); }
+  void reset(uint32_t nowMs = 0, uint8_t jitter = 0);     // forget the estimate, not the counters: a new controller is a new path
+
+  bool probeDue(uint32_t nowMs) const;
+  void probeSent(uint32_t sentUs, uint32_t nowMs, uint8_t jitter);  // sentUs is our micros() when the ping went out
+  bool pong(uint32_t sentUs, uint32_t nowUs, uint8_t hops); // false for a pong that isn't for the last ping
+  void hopsChanged(uint8_t hops);
+
+  bool valid() const { return samples > 0; }
+  uint32_t transitUs() const { return srttUs / 2; }       // one way
+  uint32_t perHopUs() const { return hops > 1 ? transitUs() / hops : transitUs(); }
+  uint32_t spreadUs() const;                              // how far either side of transitUs() a trip can plausibly be
+  uint32_t maxAgeUs(uint32_t fallbackUs) const;           // fallbackUs until there's an estimate
+  uint64_t ageUs(uint64_t timestampAgeUs) const;          // the age to correct the hue by
+
+  int32_t srttUs;                         // smoothed round trip
+  int32_t rttvarUs;                       // smoothed mean deviation from it
+  uint8_t hops;                           // to the controller, as of the last pong; 0 if the mesh doesn't say
+  uint16_t samples;                       // round trips in the estimate
+  uint8_t outliers;                       // in a row
+  bool waiting;                           // for a pong to the last ping
+  uint32_t probe;                         // and that ping's micros()
+  uint32_t lastProbeMs;
+  uint8_t jitter;                         // a random number for how far into its window the next ping goes
+
+  uint32_t probes;                        // pings sent, pongs used and outliers left out, since boot
+  uint32_t pongs;
+  uint32_t rejected;
+};
+
+#endif
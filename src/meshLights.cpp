@@ -0,0 +1,977 @@
+/*
+ *  Display/effect logic, leader election and messaging for the meshLights nodes.
+ *
+ *  This is the part of the firmware that doesn't care what it runs on.  Hardware access goes through hal.h, so the
+ *  same functions run on an ESP32 or in the host builds under src/host.
+ */
+
+#include <stdarg.h>
+#include "meshLights.h"
+#include "profiler.h"
+#include "heapTracker.h"
+#include "traceRecorder.h"
+
+// Global vars
+bool amController = false;              // flag to designate that this node is the current controller, which sets the mesh-time and pace for cycling animations
+long knownControllerID = 0;             // a little validation that you're getting broadcasts from who you expect.  Gets set during a controller election.
+uint8_t displayMode = ALONE;            // animation type -- init animation as single node.  Can be set to either ALONE or CONNECTED.
+uint8_t aloneHue = random(0,223);       // random color set on each reboot, used for the color in the "alone" animation, 223 gives room for a random number 0-32 to be added for confetti effect.
+uint8_t animationDelay = random(8,18);  // random animation speed, between (x,y) milliseconds, used to create a unique color/vibration scheme for each individual light when in "alone" mode
+uint8_t gHue = 0;                       // global, rotating color used to shift the rainbow animation
+HuePhase huePhase(HUE_PHASE_RATE(HUE_DELAY * 1000));   // gHue and the fraction of a step it's into, see shiftHue()
+uint32_t hueOrigin = 0;                 // with HUE_TIMELINE: the mesh time, modulo HUE_CYCLE_US, at which gHue is 0.  Followed from the controller.
+uint16_t messageSeq = 0;                // sequence number of the next message this node sends
+uint16_t electionEpoch = 0;             // bumped every time an election changes the controller.  The controller's goes out in its beacons.
+int32_t followedEpoch = -1;             // epoch of the last beacon followed, -1 until the first one after an election changes the controller
+DedupeCache seenMessages;               // last sequence number heard from each sender, so flooded copies are only acted on once
+BeaconRate beaconRate;                  // how soon the controller's next beacon goes out
+MeshClock meshClock;                    // mesh time without the 71-minute wrap, see meshTime()
+DriftEstimator clockDrift;              // how fast our clock runs against mesh time, see nodeTimeAdjustedCallback()
+LatencyEstimator controllerLatency;     // how long a message from the controller takes to get here, see probeLatency()
+uint8_t controllerHops = 0;             // links to the controller as of the last topology change, 0 if not known.  See changedConnectionCallback().
+CommandQueue pendingCommands;           // commands waiting for their mesh time, see runCommands()
+uint64_t lastCommandAt = 0;             // mesh time of the last mode command run: a mode in a message sent before it is out of date
+uint32_t lastSyncRequest = 0;           // millis() of the last sync request sent to the controller, 0 for none
+Outbox outbox;                          // messages waiting to go out, see sendMessage()
+PixelStream pixelStream;                // frames we stream, or are shown, see streamPixels()
+
+CRGB leds[NUM_LEDS];                    // then there was light!
+uint16_t numLeds = NUM_LEDS;            // how much of leds[] the effects draw on.  Always NUM_LEDS on the ESP32; host benchmarks shorten it to compare strip lengths.
+
+// Hardware, filled in by main.cpp (or a host build) before the first call to stepLoop()
+LedSink *ledSink = nullptr;
+MeshTransport *meshTransport = nullptr;
+Clock *localClock = nullptr;
+
+// Timers for the periodic jobs in stepLoop()
+CEveryNSeconds electionTimer(ELECTION_DELAY);
+CEveryNMillis messageTimer(MESSAGE_DELAY * 1000);
+CEveryNMillis confettiTimer(animationDelay);
+CEveryNMillis streamTimer(STREAM_FRAME_MS);
+
+static void queueStreamPieces();
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// BASICS
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// one pass of the main loop
+void stepLoop() {
+  HEAP_REPORT();                      // ahead of the scope, so the report's own printing isn't counted
+  HEAP_SCOPE(HEAP_LOOP);
+  PROFILE_BEGIN(PHASE_LOOP);
+
+  // management tasks: check connected status, update meshed nodes, check controller status and calls stepAnimation()
+  updateMesh();
+
+  // force a controller election on regular intervals
+  if (electionTimer) {
+    PROFILE_BEGIN(PHASE_ELECTION);
+    controllerElection();
+    PROFILE_END(PHASE_ELECTION);
+  }
+
+  // let everyone know which animation should be running, and where the rainbow is
+  if (messageTimer) {
+    PROFILE_BEGIN(PHASE_MESSAGE);
+    sendBeacon();
+    PROFILE_END(PHASE_MESSAGE);
+  }
+
+  // time the trip to the controller and back, now and then
+  probeLatency();
+
+  // send what that (or a mesh callback since the last pass) queued up, most important first
+  PROFILE_BEGIN(PHASE_OUTBOX);
+  queueStreamPieces();
+  outbox.flush(OUTBOX_SENDS_PER_LOOP);
+  PROFILE_END(PHASE_OUTBOX);
+
+  PROFILE_END(PHASE_LOOP);
+  PROFILE_REPORT();
+  TRACE_FLUSH();
+}
+
+void resetNodeState() {
+  amController = false;
+  knownControllerID = 0;
+  displayMode = ALONE;
+  aloneHue = random(0,223);
+  animationDelay = random(8,18);
+  gHue = 0;
+  huePhase.reset(HUE_PHASE_RATE(HUE_DELAY * 1000), localClock->micros());
+  hueOrigin = 0;
+  messageSeq = 0;
+  electionEpoch = 0;
+  followedEpoch = -1;
+  seenMessages.clear();
+  beaconRate = BeaconRate();
+  meshClock = MeshClock();
+  clockDrift.reset();
+  controllerLatency = LatencyEstimator();
+  controllerHops = 0;
+  pendingCommands.clear();
+  lastCommandAt = 0;
+  lastSyncRequest = 0;
+  outbox.clear();
+  pixelStream.reset();
+
+  electionTimer.setPeriod(ELECTION_DELAY);
+  electionTimer.reset();
+  messageTimer.setPeriod(MESSAGE_DELAY * 1000);
+  messageTimer.reset();
+  confettiTimer.setPeriod(animationDelay);
+  confettiTimer.reset();
+  streamTimer.setPeriod(STREAM_FRAME_MS);
+  streamTimer.reset();
+
+  fill_solid(leds, NUM_LEDS, CRGB::Black);
+}
+
+void saveNodeState(NodeState &state) {
+  state.amController = amController;
+  state.knownControllerID = knownControllerID;
+  state.displayMode = displayMode;
+  state.aloneHue = aloneHue;
+  state.animationDelay = animationDelay;
+  state.gHue = gHue;
+  state.huePhase = huePhase;
+  state.hueOrigin = hueOrigin;
+  state.messageSeq = messageSeq;
+  state.electionEpoch = electionEpoch;
+  state.followedEpoch = followedEpoch;
+  state.seenMessages = seenMessages;
+  state.beaconRate = beaconRate;
+  state.meshClock = meshClock;
+  state.clockDrift = clockDrift;
+  state.controllerLatency = controllerLatency;
+  state.controllerHops = controllerHops;
+  state.pendingCommands = pendingCommands;
+  state.lastCommandAt = lastCommandAt;
+  state.lastSyncRequest = lastSyncRequest;
+  state.outbox = outbox;
+  state.pixelStream = pixelStream;
+  state.electionTimer = electionTimer;
+  state.messageTimer = messageTimer;
+  state.confettiTimer = confettiTimer;
+  state.streamTimer = streamTimer;
+  memcpy(state.leds, leds, sizeof(leds));
+}
+
+void loadNodeState(const NodeState &state) {
+  amController = state.amController;
+  knownControllerID = state.knownControllerID;
+  displayMode = state.displayMode;
+  aloneHue = state.aloneHue;
+  animationDelay = state.animationDelay;
+  gHue = state.gHue;
+  huePhase = state.huePhase;
+  hueOrigin = state.hueOrigin;
+  messageSeq = state.messageSeq;
+  electionEpoch = state.electionEpoch;
+  followedEpoch = state.followedEpoch;
+  seenMessages = state.seenMessages;
+  beaconRate = state.beaconRate;
+  meshClock = state.meshClock;
+  clockDrift = state.clockDrift;
+  controllerLatency = state.controllerLatency;
+  controllerHops = state.controllerHops;
+  pendingCommands = state.pendingCommands;
+  lastCommandAt = state.lastCommandAt;
+  lastSyncRequest = state.lastSyncRequest;
+  outbox = state.outbox;
+  pixelStream = state.pixelStream;
+  electionTimer = state.electionTimer;
+  messageTimer = state.messageTimer;
+  confettiTimer = state.confettiTimer;
+  streamTimer = state.streamTimer;
+  memcpy(leds, state.leds, sizeof(leds));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// LED FUNCTIONS
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// random colored speckles that blink in and fade smoothly
+void confetti() {
+  // a nice fade effect when transitioning back from the connected/rainbow animation
+  fadeToBlackBy(leds, numLeds, 10);
+  int pos = random16(numLeds);
+  leds[pos] += CHSV(aloneHue + random8(32), 200, 255);
+}
+
+void banana_mode() {
+  fadeToBlackBy(leds, numLeds, 10);
+  uint8_t starthue = 45;
+  uint8_t endhue = 70;
+
+  fill_gradient(leds, numLeds, CHSV(starthue,255,255), CHSV(endhue,255,255), FORWARD_HUES);    // If we don't have this, the colour fill will flip around.
+  addGlitter(AMOUNT_OF_GLITTER * 2);
+}
+
+void addGlitter(fract8 chanceOfGlitter) {
+  if (random8() < chanceOfGlitter) {
+    leds[random16(numLeds)] += CRGB::White;
+  }
+}
+
+// hand the finished frame to the LED strip
+void showFrame() {
+  PROFILE_FRAME();
+  PROFILE_BEGIN(PHASE_SHOW);
+  ledSink->show(leds, numLeds);
+  PROFILE_END(PHASE_SHOW);
+}
+
+void stepAnimation(int displayMode) {
+  switch (displayMode) {
+    // "confetti" effect, not part of a mesh, searching for connections
+    case ALONE:
+      // this gives the confetti animation a unique animation rate on each reboot
+      if (confettiTimer) { confetti(); }
+
+      showFrame();
+    break;
+
+    // "rainbow" effect, you're connected!
+    case CONNECTED:
+      // another data dimension, but might be annoying.  Fades the brightness of the LEDs depending on the wifi signal strength.
+      if (FADE_BY_DISTANCE && amController == false) {
+        uint8_t newBrightness = BRIGHTNESS - (-1 * meshTransport->rssi());
+
+        ledSink->setBrightness(newBrightness);
+      }
+
+      // frames streamed to us take over from our own animation while they keep coming.  If the "super controller" is in
+      // the network use the alternate animation, otherwise, FastLED's built-in rainbow generator
+      if (pixelStream.live(localClock->millis())) {
+        uint16_t count = pixelStream.pixelCount < numLeds ? pixelStream.pixelCount : numLeds;
+
+        memcpy(leds, pixelStream.pixels, count * sizeof(CRGB));
+        fill_solid(leds + count, numLeds - count, CRGB::Black);
+      }
+      else if (knownControllerID == SUPER_CONTROLLER_ID) {
+        banana_mode();
+      }
+      else {
+        fill_rainbow(leds, numLeds, gHue, 255/numLeds*NUM_RAINBOWS);
+      }
+
+      // the controller gets a bit of glitter for visual identification
+      if (amController == true) { addGlitter(AMOUNT_OF_GLITTER); }
+
+      if (STREAM_FROM_CONTROLLER && amController == true && streamTimer) { streamPixels(leds, numLeds); }
+
+      showFrame();
+    break;
+
+    // the super controller's animation, on every node at once
+    case BANANA:
+      banana_mode();
+      if (amController == true) { addGlitter(AMOUNT_OF_GLITTER); }
+
+      showFrame();
+    break;
+  }
+}
+
+// Moves the base hue (gHue) on to animate the rainbow effect: by however long it's been since the last frame, so the
+// rainbow moves at the same speed whatever the frame rate, see huePhase.h
+void shiftHue() {
+  uint8_t before = gHue;
+
+  huePhase.advance(localClock->micros());
+  gHue = huePhase.hue();
+
+  // as the controller, announce when the base hue goes round.  Only for old firmware: beacons carry the hue now.
+  if (gHue < before && SEND_LEGACY_JSON && amController == true && meshTransport->getNodeList().size() > 0) {
+    sendMessage(MSG_KEYFRAME);
+  }
+}
+
+// jump the hue phase (and gHue with it) to where a correction says it should be by now
+static void setHuePhase(uint32_t phase) {
+  huePhase.set(phase, localClock->micros());
+  gHue = huePhase.hue();
+}
+
+static_assert(!(HUE_TIMELINE && SEND_LEGACY_JSON), "old firmware only follows KEYFRAMEs, which the hue timeline doesn't send");
+
+// the hue phase as a function of mesh time: how far round HUE_CYCLE_US it is since the hue origin, so gHue is the
+// number of HUE_DELAY steps since then, modulo 256.  Every node that agrees on mesh time and the origin gets the same
+// hue with no messages at all, and a loop that stalls just skips ahead rather than falling behind.
+uint32_t timelinePhase() {
+  uint64_t sinceOrigin = (meshTime() + HUE_CYCLE_US - hueOrigin) % HUE_CYCLE_US;
+  return (sinceOrigin << 32) / HUE_CYCLE_US;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////////
+// MESH FUNCTIONS
+//////////////////////////////////////////////////////////////////////////////////////////////
+
+// mesh time in microseconds, as 64 bits so it doesn't wrap during a show, and running at the mesh's rate in between
+// painlessMesh's adjustments rather than our oscillator's (see drift.h)
+uint64_t meshTime() {
+  return meshClock.extend(meshTransport->getNodeTime()) + clockDrift.correction(localClock->millis());
+}
+
+void updateMesh() {
+  PROFILE_BEGIN(PHASE_MESH_UPDATE);
+  meshTransport->update();
+  PROFILE_END(PHASE_MESH_UPDATE);
+
+  meshTime();                           // often enough that the 64-bit mesh time never misses a wrap
+
+  // the hue for this frame.  On our own clock it keeps the mesh's rate too, with the drift compensation's nudges.
+  if (HUE_TIMELINE) {
+    setHuePhase(timelinePhase());
+  }
+  else {
+    PROFILE_BEGIN(PHASE_HUE);
+    huePhase.shift(clockDrift.takeMicros(localClock->millis()));
+    shiftHue();
+    PROFILE_END(PHASE_HUE);
+  }
+
+  if (amController == true && displayMode == ALONE && meshTransport->getNodeList().size() > 0) {
+    displayMode = CONNECTED;
+  }
+
+  // commands due by now go ahead of the frame, so every node draws the first one after the change the same way
+  runCommands();
+
+  // animation update
+  PROFILE_BEGIN(PHASE_ANIMATION);
+  stepAnimation(displayMode);
+  PROFILE_END(PHASE_ANIMATION);
+}
+
+void controllerElection() {
+  uint32_t myNodeID = meshTransport->getNodeId();
+  uint32_t lowestNodeID = myNodeID;
+  bool badNodeDectected = false;
+
+  SimpleList<uint32_t> nodes;
+  nodes = meshTransport->getNodeList();
+
+  Serial.printf("\n>> CONTROLLER ELECTION\n");
+  Serial.printf(" . Number of nodes in mesh: %d\n", nodes.size() + 1);
+  Serial.printf(" . Mesh members: %u (< this node)", myNodeID);
+
+  for (SimpleList<uint32_t>::iterator node = nodes.begin(); node != nodes.end(); ++node) {
+    Serial.printf(" %u", *node);
+
+    // Sometimes an orphaned node (ID "0") shows up and throws off controller elections.  Skip it here and filter it
+    // from the list once we're done walking it (removing it mid-loop would invalidate the iterator).
+    if (*node == 0) {
+      badNodeDectected = true;
+    }
+    else {
+      if (*node < lowestNodeID) { lowestNodeID = *node; }
+    }
+  }
+
+  if (badNodeDectected) { nodes.remove(0); }
+
+  Serial.println();
+
+  // this is just for visibility.  The clean-up happens very fast when an orphaned node is detected.
+  if (badNodeDectected) {
+    Serial.printf("  --------------------------------------------------\n");
+    Serial.printf("  !! NODE ID \"0\" DETECTED -- DELETING FROM MESH LIST\n");
+    Serial.printf("  --------------------------------------------------\n");
+  }
+
+  Serial.printf(" . Election result: ");
+
+  if (lowestNodeID == myNodeID) {
+    Serial.printf("I am the controller (node id: %u)\n", myNodeID);
+    amController = true;
+  }
+  else {
+    Serial.printf("Node %u is the controller\n", lowestNodeID);
+    amController = false;
+  }
+
+  // only act on messages from the known controller in the mesh
+  if (knownControllerID != lowestNodeID) {
+    electionEpoch++;
+    followedEpoch = -1;
+    lastCommandAt = 0;                    // a new controller's modes aren't out of date by the old one's commands
+    controllerLatency.reset(localClock->millis(), random(256));
+    controllerHops = 0;                   // until the next topology change works it out
+  }
+
+  knownControllerID = lowestNodeID;
+
+  String ipAddr = meshTransport->localIP();
+
+  if (ipAddr == "0.0.0.0") {  // tried: WiFi.status() != WL_CONNECTED
+    Serial.printf(" . NO IP ADDRESS - WiFi Mode: %s, Status: %s (IP: %s)\n", meshTransport->linkMode(), meshTransport->linkStatus(), ipAddr.c_str());
+  }
+  else {
+    String signalHealth;
+    int32_t rssi = meshTransport->rssi();
+
+    // RSSI is the relative received signal strength in a wireless environment.  The higher the number, the stronger the signal.
+    // these values may need to by tweaked but seems to be fairly accurate in my use, in terms of "good" vs. "bad".
+    if (rssi > -60) { signalHealth = "GREAT"; }
+    if (rssi <= -60 && rssi > -70) { signalHealth = "GOOD"; }
+    if (rssi <= -70 && rssi > -90) { signalHealth = "WEAK"; }
+    if (rssi <= -90 && rssi > -100) { signalHealth = "BAD"; }
+    if (rssi <= -100) { signalHealth = "*VERY BAD*"; }
+
+    Serial.printf(" . Wifi Mode: %s, Status: %s. Signal strength: %s, %ddBm. (IP: %s) ", meshTransport->linkMode(), meshTransport->linkStatus(), signalHealth.c_str(), rssi, ipAddr.c_str());
+
+    // dim the LEDs as the signal starts to fade.  Can be turned off by setting FADE_BY_DISTANCE to false.  Doesn't apply to the elected controller.
+    if (FADE_BY_DISTANCE && amController == false) {
+      uint8_t newBrightness = BRIGHTNESS - (-1 * rssi);
+      Serial.printf("(Fading brightness to %d).", newBrightness);
+    }
+
+    Serial.println();
+  }
+
+  Serial.println();
+}
+
+// the controller's beacon: mode, hue, controller and epoch in one message, so the other nodes only need the one.  Old
+// firmware only reads displayMode (and KEYFRAME, see shiftHue()), which every node used to send.
+void sendBeacon() {
+  if (SEND_LEGACY_JSON) {
+    sendMessage(MSG_DISPLAY_MODE);
+    return;
+  }
+
+  if (amController != true) return;
+
+  size_t nodes = meshTransport->getNodeList().size();
+  if (nodes == 0) return;
+
+  sendMessage(MSG_BEACON);
+  messageTimer.setPeriod(beaconRate.next(nodes + 1));
+}
+
+// ask the controller for a sync of our own, when we know we're out of step.  At most one every SYNC_REQUEST_DELAY.
+void requestSync() {
+  if (SEND_LEGACY_JSON || HUE_TIMELINE || amController == true || knownControllerID == 0) return;
+
+  uint32_t now = localClock->millis();
+  if (lastSyncRequest != 0 && now - lastSyncRequest < SYNC_REQUEST_DELAY) return;
+
+  lastSyncRequest = now;
+  sendMessage(MSG_SYNC_REQUEST, knownControllerID);
+}
+
+// which outbox class a message goes out in
+static MessagePriority messagePriority(uint8_t type) {
+  switch (type) {
+    case MSG_BEACON:
+    case MSG_KEYFRAME:
+    case MSG_DISPLAY_MODE:
+    case MSG_SYNC_REQUEST:
+    case MSG_SYNC:
+      return PRIORITY_SYNC;
+    case MSG_COMMAND:
+      return PRIORITY_COMMAND;
+    case MSG_PIXELS:
+    case MSG_STREAM_NACK:
+      return PRIORITY_STREAM;
+    case MSG_PING:
+    case MSG_PONG:
+      return PRIORITY_TELEMETRY;
+    default:
+      return PRIORITY_DIAGNOSTIC;
+  }
+}
+
+// stamp, encode and queue a message whose payload is already filled in.  False if it didn't make it into the outbox.
+static bool queueMessage(Message &msg, uint32_t dest) {
+  msg.seq = messageSeq++;
+  msg.timestamp = meshTime();
+
+  char text[OUTBOX_TEXT_SIZE];
+  size_t length = SEND_LEGACY_JSON ? encodeLegacyMessage(msg, text, sizeof(text)) : encodeMessage(msg, text, sizeof(text));
+  if (length == 0) return false;
+
+  if (msg.type == MSG_KEYFRAME) {
+    Serial.printf(">> CONTROLLER KEYFRAME - broadcast message sent: %s\n", text);
+  }
+
+  return outbox.push(messagePriority(msg.type), dest, text, length);
+}
+
+// queue a message for one node, or for all of them (dest 0): a beacon, a KEYFRAME, the animation mode they should all
+// be in, or a sync request or answer.  It goes out at the end of this pass of stepLoop(), see outbox.h.
+void sendMessage(uint8_t type, uint32_t dest) {
+  Message msg = {};
+  msg.type = type;
+  msg.mode = displayMode;
+  msg.controller = knownControllerID;
+  msg.epoch = electionEpoch;
+  msg.hueOrigin = hueOrigin;
+
+  // the hue as of now, which can be most of a pass on from the last frame's
+  uint32_t phase = huePhase.at(localClock->micros());
+  msg.hue = phase >> 24;
+  msg.hueFraction = phase >> 8;
+  msg.hueElapsed = (phase & (HUE_PHASE_STEP - 1)) / huePhase.span(1000);
+
+  queueMessage(msg, dest);
+}
+
+// ping the controller when it's time to, see latency.h.  Old firmware wouldn't answer, and on the timeline the hue
+// doesn't depend on how long anything took to get here.
+void probeLatency() {
+  if (SEND_LEGACY_JSON || HUE_TIMELINE || amController == true || knownControllerID == 0) return;
+
+  uint32_t now = localClock->millis();
+  if (!controllerLatency.probeDue(now)) return;
+
+  Message msg = {};
+  msg.type = MSG_PING;
+  msg.probe = localClock->micros();
+
+  controllerLatency.probeSent(msg.probe, now, random(256));
+  queueMessage(msg, knownControllerID);
+}
+
+// the controller scheduling a command for every node, itself included, leadMs from now, see commands.h.  Old firmware
+// couldn't read it.  False if it wasn't queued.
+bool scheduleCommand(uint8_t type, uint8_t argument, uint32_t leadMs) {
+  if (SEND_LEGACY_JSON || amController != true) return false;
+
+  Command command;
+  command.at = meshTime() + leadMs * 1000ULL;
+  command.type = type;
+  command.argument = argument;
+  if (!pendingCommands.push(command)) return false;
+
+  if (meshTransport->getNodeList().size() == 0) return true;
+
+  Message msg = {};
+  msg.type = MSG_COMMAND;
+  msg.command = type;
+  msg.argument = argument;
+  msg.at = command.at;
+
+  // the copies are lost (or not) separately, and the receivers only queue the first
+  bool queued = false;
+  for (uint8_t i = 0; i < COMMAND_COPIES; i++) queued |= queueMessage(msg, 0);
+  return queued;
+}
+
+// run every queued command whose mesh time has come
+void runCommands() {
+  Command command;
+  uint64_t now = meshTime();
+
+  while (pendingCommands.pop(now, command)) {
+    switch (command.type) {
+      case COMMAND_DISPLAY_MODE:
+        Serial.printf(" > COMMAND -- display mode %u, %u us after its time.\n", command.argument, (uint32_t)(now - command.at));
+        displayMode = command.argument;
+        lastCommandAt = command.at;
+
+        // a node that missed the command gets the mode from the beacons: a burst of them, starting right away
+        if (amController == true) {
+          beaconRate.topologyChanged();
+          messageTimer.setPeriod(BEACON_MIN_MS);
+        }
+      break;
+    }
+  }
+}
+
+// stream a frame to every other node, see pixelStream.h.  The controller calls this with its own leds[] when
+// STREAM_FROM_CONTROLLER is set; anything else with pixels to show (a host bridge) can call it too.
+void streamPixels(const CRGB *pixels, uint16_t count) {
+  if (SEND_LEGACY_JSON) return;           // old firmware couldn't read it
+
+  size_t nodes = meshTransport->getNodeList().size();
+  if (nodes == 0) return;
+
+  pixelStream.encode(pixels, count, localClock->millis(), nodes + 1);
+}
+
+// move as many pieces of the frame being streamed into the outbox as it has room for, without pushing anything out
+static void queueStreamPieces() {
+  while (pixelStream.nextPiece < pixelStream.pieces && outbox.size() < OUTBOX_SLOTS) {
+    uint16_t offset = pixelStream.nextPiece * MESSAGE_MAX_DATA;
+    Message msg = {};
+
+    msg.type = MSG_PIXELS;
+    msg.frame = pixelStream.frame;
+    msg.base = pixelStream.base;
+    msg.fragment = pixelStream.nextPiece++;
+    msg.fragments = pixelStream.pieces;
+    msg.frameSize = pixelStream.size;
+    msg.data = pixelStream.encoded + offset;
+    msg.dataSize = pixelStream.size - offset < MESSAGE_MAX_DATA ? pixelStream.size - offset : MESSAGE_MAX_DATA;
+
+    if (!queueMessage(msg, 0)) pixelStream.degrade(localClock->millis());
+  }
+
+  // a beacon that had to push a piece out counts as falling behind too
+  uint32_t dropped = outbox.counters[PRIORITY_STREAM].dropped;
+  if (dropped != pixelStream.dropsSeen) {
+    pixelStream.dropsSeen = dropped;
+    pixelStream.degrade(localClock->millis());
+  }
+}
+
+// Serial.printf() on the ESP32 mallocs anything longer than 64 characters, so the receive path formats on the stack
+static void logPrintf(const char *format, ...) {
+  char line[160];
+  va_list args;
+
+  if (!Serial) return;
+
+  va_start(args, format);
+  vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  Serial.print(line);
+}
+
+// how old a message can be and still be acted on: MAX_MESSAGE_AGE, or less once we know how long the trip takes
+static uint32_t maxMessageAge() {
+  return controllerLatency.maxAgeUs(MAX_MESSAGE_AGE);
+}
+
+// the mesh time a message went out at.  Legacy messages only carry the low 32 bits of it.
+static uint64_t messageSent(const Message &msg) {
+  return msg.legacy ? meshClock.expand(msg.timestamp) : msg.timestamp;
+}
+
+// time between sending and receiving a broadcast, in microseconds, by the timestamp.  A sender whose clock is a little
+// ahead of ours makes it negative, which counts as brand new; one further in the future than maxMessageAge() is as
+// good as stale.  To correct a phase by, use controllerLatency.ageUs() of it, which keeps a plausible one to what the
+// trip can take.
+static uint64_t messageAge(const Message &msg) {
+  int64_t age = (int64_t)(meshTime() - messageSent(msg));
+
+  if (age >= 0) return age;
+  return age > -(int64_t)maxMessageAge() ? 0 : UINT64_MAX;
+}
+
+// this is a call from the controller to reset your global hue.  This gets all the rainbow animations synchronized.
+static void handleKeyframe(uint32_t from, const Message &msg) {
+  if (HUE_TIMELINE || from != knownControllerID) return;
+
+  uint64_t age = messageAge(msg);
+
+  logPrintf(" > KEYFRAME from %u -- Timestamp: %llu, offset: %lld ms. Local gHue is %u. ", from,
+    (unsigned long long)msg.timestamp, (long long)(age / 1000), gHue);
+
+  // message time in transit is within bounds
+  if (age < maxMessageAge()) {
+    // when receiving a KEYFRAME message, only reset the global hue if it's out of sync
+    if (255-gHue>12 && 255-gHue<243) {
+      // testing this out.  Instead of a slightly delayed "reset to zero" message, trying to calculate how far ahead the controller is by the time the message was received.
+      uint32_t newPhase = huePhase.span(controllerLatency.ageUs(age));
+      uint8_t newHue = newPhase >> 24;
+
+      if (gHue != newHue) { // don't bother logging a new value if they're already in sync
+        logPrintf("(RESETTING gHue to %u.)", newHue);
+      }
+
+      setHuePhase(newPhase);
+    }
+  }
+  else {
+    // discard older messages.  Divide by 1,000 to convert microseconds to milliseconds.
+    logPrintf("(IGNORED: message is older than %u ms.)", maxMessageAge()/1000);
+  }
+
+  Serial.println();
+}
+
+// the controller's mode, from any of its messages that say it.  One sent before the last mode command we ran (a
+// beacon that was already on its way when the command's time came) still has the old mode, and is left alone.
+static void followMode(const Message &msg) {
+  if (messageSent(msg) < lastCommandAt) return;
+
+  displayMode = msg.mode;
+}
+
+// the controller telling everyone which animation should be running
+static void handleDisplayMode(uint32_t from, const Message &msg) {
+  if (from != knownControllerID) return;
+
+  logPrintf("Display update from %u.  Setting mode to %u.", from, msg.mode);
+  followMode(msg);
+}
+
+// on the timeline the only thing to follow about the controller's hue is where its timeline starts
+static void followHueOrigin(uint32_t from, const Message &msg) {
+  if (!msg.hasHueOrigin || msg.hueOrigin % HUE_CYCLE_US == hueOrigin) return;
+
+  logPrintf(" > HUE ORIGIN from %u -- moving from %u to %u us.\n", from, hueOrigin, msg.hueOrigin % HUE_CYCLE_US);
+  hueOrigin = msg.hueOrigin % HUE_CYCLE_US;
+}
+
+// the hue phase a beacon or sync was sent at, moved on by how long it's been on the way.  Older firmware only says
+// which step (and, in a sync, the millisecond within it).
+static uint32_t messagePhase(const Message &msg, uint64_t ageUs) {
+  uint32_t phase = (uint32_t)msg.hue << 24;
+
+  if (msg.hasHueFraction) phase |= (uint32_t)msg.hueFraction << 8;
+  else if (msg.type == MSG_SYNC) phase += huePhase.span(msg.hueElapsed * 1000);
+  else phase += HUE_PHASE_STEP / 2;     // somewhere in the step: halfway is the best guess
+
+  return phase + huePhase.span(ageUs);
+}
+
+// the controller's beacon: follow its mode, and its hue if ours has drifted out of the dead band.  The first beacon
+// after an election changes the controller (or after the controller's own epoch moves) is followed regardless.
+static void handleBeacon(uint32_t from, const Message &msg) {
+  if (from != knownControllerID || msg.controller != from) return;
+
+  meshClock.follow(msg.timestamp);      // count mesh time wraps the way the controller does
+  uint64_t age = messageAge(msg);
+
+  followMode(msg);
+
+  if (HUE_TIMELINE) {
+    followedEpoch = msg.epoch;
+    followHueOrigin(from, msg);
+    return;
+  }
+
+  // the beacon says what time it was for, so unlike a KEYFRAME it's still good after a slow trip, right up until the
+  // next one could be due
+  if (age >= BEACON_MAX_MS * 1000ULL) {
+    logPrintf(" > BEACON from %u -- IGNORED: message is older than %u ms.\n", from, BEACON_MAX_MS);
+    return;
+  }
+
+  // where the controller's hue is by now
+  age = controllerLatency.ageUs(age);
+  uint32_t newPhase = messagePhase(msg, age);
+  uint8_t newHue = newPhase >> 24;
+  int8_t error = newHue - gHue;
+  bool resync = msg.epoch != followedEpoch;
+
+  followedEpoch = msg.epoch;
+
+  if (resync || error > HUE_DEAD_BAND || error < -HUE_DEAD_BAND) {
+    logPrintf(" > BEACON from %u -- epoch %u, offset: %u ms. RESETTING gHue from %u to %u.\n", from, msg.epoch, (uint32_t)(age/1000), gHue, newHue);
+    setHuePhase(newPhase);
+
+    // a beacon from older firmware only gets us to the nearest hue step.  Having drifted that far, ask for the exact phase.
+    if (!resync && !msg.hasHueFraction) requestSync();
+  }
+}
+
+// a node asking the controller (us, hopefully) for its own copy of the phase
+static void handleSyncRequest(uint32_t from, const Message &msg) {
+  if (SEND_LEGACY_JSON || amController != true) return;   // a sync has no old form, see encodeLegacyMessage()
+
+  logPrintf(" > SYNC REQUEST from %u\n", from);
+  sendMessage(MSG_SYNC, from);
+}
+
+// the controller's answer to our sync request: a beacon with the phase within the hue step, so both the hue and the
+// moment of the next hue step line up with the controller's
+static void handleSync(uint32_t from, const Message &msg) {
+  if (from != knownControllerID || msg.controller != from) return;
+
+  meshClock.follow(msg.timestamp);
+  uint64_t age = messageAge(msg);
+
+  if (HUE_TIMELINE) {
+    followMode(msg);
+    followedEpoch = msg.epoch;
+    followHueOrigin(from, msg);
+    return;
+  }
+
+  if (age >= BEACON_MAX_MS * 1000ULL) return;
+
+  age = controllerLatency.ageUs(age);
+
+  followMode(msg);
+  followedEpoch = msg.epoch;
+  setHuePhase(messagePhase(msg, age));
+
+  logPrintf(" > SYNC from %u -- offset: %u ms. gHue is now %u.\n", from, (uint32_t)(age/1000), gHue);
+}
+
+// a piece of a streamed frame.  One that can't be shown without a frame we missed gets the sender asked for a keyframe.
+static void handlePixels(uint32_t from, const Message &msg) {
+  uint32_t now = localClock->millis();
+
+  if (pixelStream.receive(from, msg, now) != STREAM_NEED_KEYFRAME) return;
+  if (SEND_LEGACY_JSON) return;           // a NACK has no old form, see encodeLegacyMessage()
+  if (pixelStream.lastNackMs != 0 && now - pixelStream.lastNackMs < STREAM_NACK_DELAY) return;
+
+  Message nack = {};
+  nack.type = MSG_STREAM_NACK;
+  nack.frame = msg.frame;
+
+  pixelStream.lastNackMs = now;
+  pixelStream.counters.nacks++;
+  queueMessage(nack, from);
+}
+
+// a node missed part of our stream: keyframes only for a while
+static void handleStreamNack(uint32_t from, const Message &msg) {
+  if (pixelStream.frame == 0) return;
+
+  logPrintf(" > STREAM NACK from %u for frame %u\n", from, msg.frame);
+  pixelStream.counters.nacks++;
+  pixelStream.degrade(localClock->millis());
+}
+
+// someone timing the round trip to us: straight back
+static void handlePing(uint32_t from, const Message &msg) {
+  if (SEND_LEGACY_JSON) return;           // a pong has no old form, see encodeLegacyMessage()
+
+  Message pong = {};
+  pong.type = MSG_PONG;
+  pong.probe = msg.probe;
+
+  queueMessage(pong, from);
+}
+
+// the controller's answer to our ping
+static void handlePong(uint32_t from, const Message &msg) {
+  if (from != knownControllerID) return;
+  if (!controllerLatency.pong(msg.probe, localClock->micros(), controllerHops)) return;
+
+  logPrintf(" > PONG from %u -- round trip %u us.  Transit now %u +- %u us, %u hops at %u us.\n", from,
+    localClock->micros() - msg.probe, controllerLatency.transitUs(), controllerLatency.spreadUs(), controllerLatency.hops,
+    controllerLatency.perHopUs());
+}
+
+// a command from the controller, for later
+static void handleCommand(uint32_t from, const Message &msg) {
+  if (from != knownControllerID) return;
+
+  Command command;
+  command.at = msg.at;
+  command.type = msg.command;
+  command.argument = msg.argument;
+
+  if (pendingCommands.push(command)) {
+    logPrintf(" > COMMAND from %u -- %u (%u), in %lld ms.\n", from, msg.command, msg.argument,
+      (long long)((int64_t)(msg.at - meshTime()) / 1000));
+  }
+}
+
+typedef void (*MessageHandler)(uint32_t from, const Message &msg);
+
+// indexed by MessageType
+static const MessageHandler messageHandlers[NUM_MESSAGE_TYPES] = {
+  nullptr,
+  handleKeyframe,                       // MSG_KEYFRAME
+  handleDisplayMode,                    // MSG_DISPLAY_MODE
+  handleBeacon,                         // MSG_BEACON
+  handleSyncRequest,                    // MSG_SYNC_REQUEST
+  handleSync,                           // MSG_SYNC
+  handlePixels,                         // MSG_PIXELS
+  handleStreamNack,                     // MSG_STREAM_NACK
+  handlePing,                           // MSG_PING
+  handlePong,                           // MSG_PONG
+  handleCommand,                        // MSG_COMMAND
+};
+
+// every mesh message lands here.  This runs inside mesh.update(), ahead of the next show(), so it decodes straight
+// from the received text and allocates nothing.
+void receivedCallback(uint32_t from, String &packet) {
+  HEAP_SCOPE(HEAP_RECEIVE);
+  TRACE_RECEIVED(from, packet);
+  Message msg;
+
+  if (!decodeHeader(packet.c_str(), packet.length(), msg)) {
+    logPrintf("!! ERROR: unreadable message from %u: %.40s\n", from, packet.c_str());
+    return;
+  }
+
+  // legacy messages carry no sequence number, they're always acted on.  Nor do pieces of a streamed frame go through
+  // the cache: they're sent back to back and can overtake one another, and the stream sorts out its own stale and
+  // repeated pieces.
+  if (!msg.legacy && msg.type != MSG_PIXELS && seenMessages.check(from, msg.seq, (uint32_t)msg.timestamp) != DEDUPE_NEW) return;
+  if (!decodePayload(packet.c_str(), packet.length(), msg)) {
+    logPrintf("!! ERROR: unreadable message from %u: %.40s\n", from, packet.c_str());
+    return;
+  }
+
+  MessageHandler handler = msg.type < NUM_MESSAGE_TYPES ? messageHandlers[msg.type] : nullptr;
+  if (handler) handler(from, msg);
+}
+
+void newConnectionCallback(uint32_t nodeId) {
+    Serial.printf("\n>> NEW CONNECTION, nodeId = %u\n", nodeId);
+}
+
+// this gets called when a node is added or removed from the mesh, so set the controller to the node with the lowest chip id
+void changedConnectionCallback() {
+  HEAP_SCOPE(HEAP_CHANGED_CONNECTIONS);
+  TRACE_CHANGED();
+  Serial.printf("\n > CHANGED CONNECTIONS: %s\n", meshTransport->subConnectionJson().c_str());
+
+  // calling an election when mesh configuration changes
+  controllerElection();
+
+  SimpleList<uint32_t> nodes = meshTransport->getNodeList();
+
+  // if the node count is zero, go back to the "alone" animation.  Anything other than alone is where the controller
+  // put the mesh, and stays.
+  if (nodes.size() > 0) {
+    if (displayMode == ALONE) displayMode = CONNECTED;
+  }
+  else {
+    displayMode = ALONE;
+  }
+
+  // the way to the controller may be longer or shorter now.  Worked out here, where it changes, because painlessMesh
+  // builds a copy of its whole node tree to tell: too much for every pong.
+  controllerHops = amController == true ? 0 : meshTransport->hopsTo(knownControllerID);
+  if (amController != true) controllerLatency.hopsChanged(controllerHops);
+
+  // someone new may be waiting to sync: a burst of beacons, starting right away
+  if (!SEND_LEGACY_JSON) {
+    beaconRate.topologyChanged();
+    messageTimer.setPeriod(BEACON_MIN_MS);
+  }
+}
+
+void nodeTimeAdjustedCallback(int32_t offset) {
+    HEAP_SCOPE(HEAP_TIME_ADJUSTED);
+    TRACE_TIME_ADJUSTED(offset);
+    // what the drift compensation already had covered doesn't move anything, only the residual does
+    int32_t residual = clockDrift.adjusted(offset, localClock->millis());
+    Serial.printf(" + TIME: Adjusted time to %u, Offset was %d, %d unpredicted.  Drift now %d ppb.\n",
+      meshTransport->getNodeTime(), offset, residual, clockDrift.ppb);
+
+    // a big step in mesh time moves where every node thinks the rainbow is: beacon again soon, or, when it's only this
+    // node's time that moved, ask the controller for a sync of its own.  On the timeline the hue moves with the time,
+    // so there's nothing to correct.
+    if (!HUE_TIMELINE && beaconRate.timeAdjusted(residual, localClock->millis()) && !SEND_LEGACY_JSON) {
+      if (amController == true) messageTimer.setPeriod(BEACON_MIN_MS);
+      else requestSync();
+    }
+}
+
+// sort the given list of nodes
+void sortNodeList(SimpleList<uint32_t> &nodes) {
+  SimpleList<uint32_t> nodes_sorted;
+  SimpleList<uint32_t>::iterator smallest_node;
+
+  // sort the node list
+  while (nodes.size() > 0) {
+    // find the smallest one
+    smallest_node = nodes.begin();
+
+    for (SimpleList<uint32_t>::iterator node = nodes.begin(); node != nodes.end(); ++node) { if (*node < *smallest_node) smallest_node = node; }
+
+    // add it to the sorted list and remove it from the old list
+    nodes_sorted.push_back(*smallest_node);
+    nodes.erase(smallest_node);
+  }
+
+  // copy the sorted list back into the now empty nodes list
+  for (SimpleList<uint32_t>::iterator node = nodes_sorted.begin(); node != nodes_sorted.end(); ++node) nodes.push_back(*node);
+}
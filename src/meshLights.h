@@ -0,0 +1,156 @@
+/*
+ *  Configuration, shared state and prototypes for the meshLights display/mesh logic.
+ *
+ *  Everything declared here is hardware-agnostic: it talks to the LED strip, the mesh and the clock only through the
+ *  interfaces in hal.h, so the same code runs on the ESP32 (main.cpp) and on a host machine (src/host).
+ */
+
+#ifndef MESHLIGHTS_H
+#define MESHLIGHTS_H
+
+#define FASTLED_INTERNAL               // this needs to come before #include <FastLED.h> to suppress pragma messages during compile time in the Arduino IDE.
+#define ARDUINOJSON_USE_LONG_LONG 1    // default to 'long long' rather than just 'long', node time is calculated in microseconds, giving the json library some sizing expectations.
+
+#include <Arduino.h>
+#include <FastLED.h>
+#include "hal.h"
+#include "protocol.h"
+#include "dedupe.h"
+#include "beaconRate.h"
+#include "meshTime.h"
+#include "drift.h"
+#include "latency.h"
+#include "commands.h"
+#include "huePhase.h"
+#include "outbox.h"
+
+// LED setup
+#ifndef NUM_LEDS
+#define NUM_LEDS              60           // how many LEDs in your strand?
+#endif
+#define DATA_PIN              13           // your board's data pin connected to your LEDs
+#define LED_TYPE              WS2812B      // WS2812B or WS2811?
+#define BRIGHTNESS            128          // built-in with FastLED, range: 0-255 (recall that each pixel uses ~60mA when set to white at full brightness, so full strip power consumption is roughly: 60mA * NUM_LEDs * (BRIGHTNESS / 255)
+#define HUE_DELAY             12           // num milliseconds (ms) between hue shifts.  Drop this number to speed up the rainbow effect, raise it to slow it down.
+#define HUE_CYCLE_US          ((uint32_t)256 * HUE_DELAY * 1000)   // num microseconds for gHue to go all the way round
+#define AMOUNT_OF_GLITTER     10           // "glitter" effect applied to the controller node for visual identification.  range: 0-255.
+#define FADE_BY_DISTANCE      false        // boolean that makes the brightness of the LEDs based on wifi signal strength.  Set to false if you want them to use the global BRIGHTNESS value instead.
+#define NUM_RAINBOWS          .25          // number of complete rainbows to show on the LED strip at once.  This is the (poorly documented) "deltaHue" variable; basically it determines the increment size of hue shifts between pixels.  Based on my implementation, a value of "1" visually spreads the rainbow effect over the whole strip, "2" will compress it and show two full rainbows patterns, etc.  Values between 0 and 1 (.8 for example) also work, but stretch rather than compress the rainbow on the strip.
+
+#include "pixelStream.h"                   // needs NUM_LEDS
+
+// Mesh setup
+#define   MESH_SSID           "LEDMesh01"  // the broadcast name of your little mesh network
+#define   MESH_PASSWORD       "foofoofoo"  // network password
+#define   MESH_PORT           5555         // in a busy space?  Isolate your mesh with a specific port as well
+#define   ELECTION_DELAY      10           // num seconds between forced controller elections
+#define   MESSAGE_DELAY       2            // num seconds between broadcast messages with SEND_LEGACY_JSON.  Beacons adapt, see beaconRate.h.
+#define   HUE_DEAD_BAND       12           // num hue steps a node can be off the controller's before a beacon corrects it
+#define   SYNC_REQUEST_DELAY  1000         // num milliseconds a node waits before asking the controller for another sync
+#ifndef HUE_TIMELINE
+#define   HUE_TIMELINE        false        // work gHue out from mesh time every frame (see timelinePhase()) instead of running it on our own clock and correcting it from beacons
+#endif
+#define   MAX_MESSAGE_AGE     250000       // num microseconds ago that a message from the controller can be acted upon, until latency.h has timed the trip; never more after. (250,000 microseconds = 250 milliseconds(ms), which seems to work well)
+#ifndef STREAM_FROM_CONTROLLER
+#define   STREAM_FROM_CONTROLLER false     // the controller streams its frames to the other nodes, instead of each one rendering its own (see pixelStream.h)
+#endif
+#define   SEND_LEGACY_JSON    false        // send the old JSON messages instead of binary ones, while some nodes still run firmware that only reads those
+#define   SUPER_CONTROLLER_ID 302673429    // this gives you a special node id that changes the animation.  I'm using it for an art car as a special node in the mesh.  It might be used to the effect of a teacher coming into the classroom.
+
+// Mesh states
+#define ALONE     1
+#define CONNECTED 2
+#define BANANA    3                        // not a state the mesh gets into by itself: the super controller's animation, on every node, when the controller sends it as a command (see scheduleCommand())
+
+// Main loop
+void stepLoop();
+
+// LED function prototypes
+void confetti();
+void banana_mode();
+void addGlitter(fract8 chanceOfGlitter);
+void stepAnimation(int displayMode);
+void showFrame();
+void shiftHue();
+uint32_t timelinePhase();
+
+// Mesh function prototypes
+uint64_t meshTime();
+void updateMesh();
+void sendBeacon();
+void sendMessage(uint8_t type, uint32_t dest = 0);
+void requestSync();
+void probeLatency();
+bool scheduleCommand(uint8_t type, uint8_t argument, uint32_t leadMs = COMMAND_LEAD_MS);
+void runCommands();
+void streamPixels(const CRGB *pixels, uint16_t count);
+void controllerElection();
+void receivedCallback(uint32_t from, String &msg);
+void newConnectionCallback(uint32_t nodeId);
+void changedConnectionCallback();
+void nodeTimeAdjustedCallback(int32_t offset);
+void sortNodeList(SimpleList<uint32_t> &nodes);
+
+// Global vars
+extern bool amController;
+extern long knownControllerID;
+extern uint8_t displayMode;
+extern uint8_t aloneHue;
+extern uint8_t animationDelay;
+extern uint8_t gHue;
+extern HuePhase huePhase;
+extern uint32_t hueOrigin;
+extern uint16_t messageSeq;
+extern uint16_t electionEpoch;
+extern int32_t followedEpoch;
+extern DedupeCache seenMessages;
+extern BeaconRate beaconRate;
+extern MeshClock meshClock;
+extern DriftEstimator clockDrift;
+extern LatencyEstimator controllerLatency;
+extern uint8_t controllerHops;
+extern CommandQueue pendingCommands;
+extern uint64_t lastCommandAt;
+extern uint32_t lastSyncRequest;
+extern Outbox outbox;
+extern PixelStream pixelStream;
+extern CRGB leds[NUM_LEDS];
+extern uint16_t numLeds;
+
+// Everything a node remembers between calls into the logic.  The firmware is only ever one node and never needs this;
+// host builds that run many nodes in one process (the simulator) keep one per node and swap it in around every call.
+struct NodeState {
+  bool amController;
+  long knownControllerID;
+  uint8_t displayMode;
+  uint8_t aloneHue;
+  uint8_t animationDelay;
+  uint8_t gHue;
+  HuePhase huePhase;
+  uint32_t hueOrigin;
+  uint16_t messageSeq;
+  uint16_t electionEpoch;
+  int32_t followedEpoch;
+  DedupeCache seenMessages;
+  BeaconRate beaconRate;
+  MeshClock meshClock;
+  DriftEstimator clockDrift;
+  LatencyEstimator controllerLatency;
+  uint8_t controllerHops;
+  CommandQueue pendingCommands;
+  uint64_t lastCommandAt;
+  uint32_t lastSyncRequest;
+  Outbox outbox;
+  PixelStream pixelStream;
+  CEveryNSeconds electionTimer;
+  CEveryNMillis messageTimer;
+  CEveryNMillis confettiTimer;
+  CEveryNMillis streamTimer;
+  CRGB leds[NUM_LEDS];
+};
+
+void resetNodeState();                          // back to power-on values, timers start counting from now
+void saveNodeState(NodeState &state);
+void loadNodeState(const NodeState &state);
+
+#endif
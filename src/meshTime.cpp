@@ -0,0 +1,27 @@
+/*
+ *  64-bit mesh time, see meshTime.h.
+ */
+
+#include "meshTime.h"
+
+uint64_t MeshClock::extend(uint32_t now) {
+  if (!started) {
+    last = now;
+    started = true;
+  }
+
+  last = expand(now);
+  return last;
+}
+
+uint64_t MeshClock::expand(uint32_t time) const {
+  return last + (int64_t)(int32_t)(time - (uint32_t)last);
+}
+
+void MeshClock::follow(uint64_t time) {
+  if (!started) return;
+
+  // whole wraps between the two, rounded to the nearest
+  int64_t wraps = (int64_t)(time - last + 0x80000000ULL) >> 32;
+  last += (uint64_t)wraps << 32;
+}
@@ -0,0 +1,30 @@
+/*
+ *  64-bit mesh time.
+ *
+ *  painlessMesh keeps mesh time as 32-bit microseconds, which wraps every 71 minutes.  MeshClock extends it to 64 bits
+ *  by watching the low half go by: any step of less than half the range (about 35 minutes), forwards or back, is taken
+ *  as just that, so time sync adjustments are fine and a wrap carries into the high half.  It has to see the 32-bit
+ *  time at least that often; stepLoop() reads it every pass.
+ *
+ *  Each node only counts the wraps it has seen itself, so nodes that joined on either side of a wrap disagree by one.
+ *  follow() takes a 64-bit time heard from the controller and adopts its count, the same way nodes follow its hue.
+ */
+
+#ifndef MESHTIME_H
+#define MESHTIME_H
+
+#include <stdint.h>
+
+class MeshClock {
+public:
+  MeshClock() : last(0), started(false) {}
+
+  uint64_t extend(uint32_t now);            // the current 32-bit mesh time, as 64 bits
+  uint64_t expand(uint32_t time) const;     // some other 32-bit mesh time within 35 minutes of the last one extended
+  void follow(uint64_t time);               // a 64-bit mesh time from the controller, sent at about the last one extended
+
+  uint64_t last;
+  bool started;
+};
+
+#endif
@@ -0,0 +1,93 @@
+/*
+ *  Outbound message queue, see outbox.h.
+ */
+
+#include <string.h>
+#include "outbox.h"
+#include "hal.h"
+
+bool Outbox::push(MessagePriority priority, uint32_t dest, const char *text, size_t length) {
+  if (length >= OUTBOX_TEXT_SIZE) {
+    counters[priority].dropped++;
+    return false;
+  }
+
+  Entry *slot = nullptr;
+  Entry *victim = nullptr;
+
+  for (Entry &entry : entries) {
+    if (!entry.used) {
+      slot = &entry;
+      break;
+    }
+
+    // least important, then oldest
+    if (!victim || entry.priority > victim->priority || (entry.priority == victim->priority && (int32_t)(entry.order - victim->order) < 0)) {
+      victim = &entry;
+    }
+  }
+
+  if (!slot) {
+    if (victim->priority < priority) {
+      counters[priority].dropped++;
+      return false;
+    }
+
+    counters[victim->priority].dropped++;
+    slot = victim;
+  }
+
+  slot->used = true;
+  slot->priority = priority;
+  slot->length = length;
+  slot->dest = dest;
+  slot->order = nextOrder++;
+  memcpy(slot->text, text, length);
+  slot->text[length] = '\0';
+
+  counters[priority].queued++;
+  return true;
+}
+
+Outbox::Entry *Outbox::next() {
+  Entry *best = nullptr;
+
+  for (Entry &entry : entries) {
+    if (!entry.used) continue;
+    if (!best || entry.priority < best->priority || (entry.priority == best->priority && (int32_t)(entry.order - best->order) < 0)) {
+      best = &entry;
+    }
+  }
+
+  return best;
+}
+
+uint8_t Outbox::flush(uint8_t limit) {
+  uint8_t sent = 0;
+  Entry *entry;
+
+  while (sent < limit && (entry = next()) != nullptr) {
+    String packet = entry->text;
+    bool ok = entry->dest == 0 ? meshTransport->sendBroadcast(packet) : meshTransport->sendSingle(entry->dest, packet);
+
+    if (ok) counters[entry->priority].sent++;
+    else counters[entry->priority].failed++;
+
+    entry->used = false;
+    sent++;
+  }
+
+  return sent;
+}
+
+void Outbox::clear() {
+  memset(entries, 0, sizeof(entries));
+  memset(counters, 0, sizeof(counters));
+  nextOrder = 0;
+}
+
+uint8_t Outbox::size() const {
+  uint8_t count = 0;
+  for (const Entry &entry : entries) count += entry.used;
+  return count;
+}
@@ -0,0 +1,69 @@
+/*
+ *  Outbound message queue.
+ *
+ *  sendMessage() doesn't hand messages to the mesh itself, it queues them here, and stepLoop() sends what's queued once
+ *  per pass, most important class first and oldest first within a class, at most OUTBOX_SENDS_PER_LOOP at a time.  The
+ *  queue is OUTBOX_SLOTS fixed entries; streamed frames are fed in as it has room (see streamPixels()).  When it's
+ *  full, a new message pushes out the oldest one of the least important class queued, unless everything queued is more
+ *  important than it, in which case it's the one dropped.  So nothing below PRIORITY_SYNC can hold up a beacon, however
+ *  much of it there is.
+ */
+
+#ifndef OUTBOX_H
+#define OUTBOX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "protocol.h"
+
+#define OUTBOX_SLOTS           8
+#define OUTBOX_SENDS_PER_LOOP  4
+#define OUTBOX_TEXT_SIZE       (MESSAGE_MAX_TEXT + 32)   // room for the legacy JSON too
+
+static_assert(OUTBOX_TEXT_SIZE <= 255, "an entry's length is a uint8_t");
+
+// most important first
+enum MessagePriority {
+  PRIORITY_SYNC,                          // beacons, keyframes, sync requests and answers
+  PRIORITY_COMMAND,                       // things the nodes should do
+  PRIORITY_STREAM,                        // pixel frames and their NACKs, see pixelStream.h
+  PRIORITY_TELEMETRY,                     // latency pings and pongs, see latency.h
+  PRIORITY_DIAGNOSTIC,
+  NUM_PRIORITIES
+};
+
+struct OutboxCounters {
+  uint32_t queued;
+  uint32_t sent;
+  uint32_t dropped;                       // never sent: pushed out, or turned away because the queue was full
+  uint32_t failed;                        // handed to the mesh, which refused it
+};
+
+class Outbox {
+public:
+  Outbox() { clear(); }
+
+  bool push(MessagePriority priority, uint32_t dest, const char *text, size_t length);  // dest 0 broadcasts.  False if it was dropped.
+  uint8_t flush(uint8_t limit);           // sends up to limit messages, returns how many it sent
+  void clear();                           // empty the queue, and zero the counters
+  uint8_t size() const;
+
+  OutboxCounters counters[NUM_PRIORITIES];
+
+private:
+  struct Entry {
+    bool used;
+    uint8_t priority;
+    uint8_t length;
+    uint32_t dest;
+    uint32_t order;                       // when it was queued, for oldest first
+    char text[OUTBOX_TEXT_SIZE];
+  };
+
+  Entry *next();                          // the entry to send next, or nullptr
+
+  Entry entries[OUTBOX_SLOTS];
+  uint32_t nextOrder;
+};
+
+#endif
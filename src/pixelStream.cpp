@@ -0,0 +1,239 @@
+/*
+ *  Pixel streaming, see pixelStream.h.
+ */
+
+#include <string.h>
+#include "meshLights.h"
+
+// a pixel as it's encoded: itself, or what changed since the base
+static inline CRGB encodedPixel(const CRGB *pixels, const CRGB *base, uint16_t i) {
+  if (!base) return pixels[i];
+  return CRGB(pixels[i].r ^ base[i].r, pixels[i].g ^ base[i].g, pixels[i].b ^ base[i].b);
+}
+
+size_t rleEncode(const CRGB *pixels, const CRGB *base, uint16_t count, uint8_t *out, size_t capacity) {
+  size_t at = 0;
+  uint16_t i = 0;
+
+  while (i < count) {
+    CRGB pixel = encodedPixel(pixels, base, i);
+    uint16_t run = 1;
+
+    while (i + run < count && run < 129 && encodedPixel(pixels, base, i + run) == pixel) run++;
+
+    if (run >= 2) {
+      if (at + 4 > capacity) return 0;
+
+      out[at++] = run + 126;
+      out[at++] = pixel.r;
+      out[at++] = pixel.g;
+      out[at++] = pixel.b;
+      i += run;
+      continue;
+    }
+
+    // as they are, up to where the next run starts
+    uint16_t literal = 1;
+    while (i + literal < count && literal < 128 &&
+      !(i + literal + 1 < count && encodedPixel(pixels, base, i + literal) == encodedPixel(pixels, base, i + literal + 1))) {
+      literal++;
+    }
+
+    if (at + 1 + literal * 3 > capacity) return 0;
+
+    out[at++] = literal - 1;
+    for (uint16_t k = 0; k < literal; k++) {
+      CRGB p = encodedPixel(pixels, base, i + k);
+      out[at++] = p.r;
+      out[at++] = p.g;
+      out[at++] = p.b;
+    }
+
+    i += literal;
+  }
+
+  return at;
+}
+
+uint16_t rleDecode(const uint8_t *in, size_t length, CRGB *pixels, uint16_t capacity, bool delta) {
+  size_t at = 0;
+  uint32_t total = 0;
+
+  // check it all first, so a bad frame never half-lands
+  while (at < length) {
+    uint8_t c = in[at++];
+    uint16_t n = c < 128 ? c + 1 : c - 126;
+
+    at += c < 128 ? n * 3 : 3;
+    total += n;
+  }
+
+  if (at != length || total == 0 || total > 0xFFFF) return 0;
+
+  at = 0;
+  uint16_t i = 0;
+
+  while (at < length) {
+    uint8_t c = in[at++];
+    uint16_t n = c < 128 ? c + 1 : c - 126;
+
+    for (uint16_t k = 0; k < n; k++, i++) {
+      const uint8_t *p = in + at + (c < 128 ? k * 3 : 0);
+      if (i >= capacity) continue;
+
+      if (delta) {
+        pixels[i].r ^= p[0];
+        pixels[i].g ^= p[1];
+        pixels[i].b ^= p[2];
+      }
+      else {
+        pixels[i] = CRGB(p[0], p[1], p[2]);
+      }
+    }
+
+    at += c < 128 ? n * 3 : 3;
+  }
+
+  return total;
+}
+
+void PixelStream::reset() {
+  memset(&counters, 0, sizeof(counters));
+
+  frame = 0;
+  base = 0;
+  size = 0;
+  pieces = 0;
+  nextPiece = 0;
+  dropsSeen = 0;
+  sentCount = 0;
+  tokens = STREAM_AIRTIME_BUDGET;
+  lastEncodeMs = 0;
+  lastKeyframeMs = 0;
+  degradedUntilMs = 0;
+
+  pixelCount = 0;
+  hasFrame = false;
+  shownFrame = 0;
+  lastFrameMs = 0;
+  source = 0;
+  lastNackMs = 0;
+
+  assembling = 0;
+  assemblingBase = 0;
+  assemblingSize = 0;
+  assemblingPieces = 0;
+  memset(received, 0, sizeof(received));
+}
+
+size_t PixelStream::encode(const CRGB *pixels, uint16_t count, uint32_t nowMs, uint32_t nodes) {
+  if (count > NUM_LEDS) count = NUM_LEDS;
+
+  // refill the bucket, a second's worth at most.  A frame bigger than that still goes out when the bucket isn't
+  // empty, and leaves it owing.
+  int64_t refill = (int64_t)(nowMs - lastEncodeMs) * STREAM_AIRTIME_BUDGET / 1000;
+  tokens = tokens + refill > STREAM_AIRTIME_BUDGET ? STREAM_AIRTIME_BUDGET : tokens + refill;
+  lastEncodeMs = nowMs;
+
+  bool changed = count != sentCount || memcmp(pixels, sent, count * sizeof(CRGB)) != 0;
+  bool keyframeDue = count != sentCount || nowMs - lastKeyframeMs >= STREAM_KEYFRAME_MS;
+  bool degraded = (int32_t)(nowMs - degradedUntilMs) < 0;
+
+  if (!changed && !keyframeDue) return 0;
+
+  // the last frame isn't all out yet, and its pieces are still in encoded[]: the link isn't keeping up
+  if (nextPiece < pieces || tokens <= 0) {
+    if (nextPiece < pieces) degrade(nowMs);
+    counters.skipped++;
+    return 0;
+  }
+
+  size_t encodedSize = 0;
+  if (!keyframeDue && !degraded) encodedSize = rleEncode(pixels, sent, count, encoded, sizeof(encoded));
+
+  bool keyframe = encodedSize == 0;
+  if (keyframe) encodedSize = rleEncode(pixels, nullptr, count, encoded, sizeof(encoded));
+  if (encodedSize == 0) return 0;
+
+  size = encodedSize;
+  pieces = (size + MESSAGE_MAX_DATA - 1) / MESSAGE_MAX_DATA;
+  nextPiece = 0;
+  tokens -= (int64_t)(size + pieces * STREAM_PIECE_OVERHEAD) * nodes;
+
+  base = frame;
+  frame++;
+
+  if (keyframe) {
+    base = frame;
+    lastKeyframeMs = nowMs;
+    counters.keyframes++;
+  }
+  else {
+    counters.deltas++;
+  }
+
+  memcpy(sent, pixels, count * sizeof(CRGB));
+  sentCount = count;
+  return size;
+}
+
+void PixelStream::degrade(uint32_t nowMs) {
+  degradedUntilMs = nowMs + STREAM_DEGRADED_MS;
+}
+
+StreamResult PixelStream::receive(uint32_t from, const Message &msg, uint32_t nowMs) {
+  bool keyframe = msg.base == msg.frame;
+
+  // one stream at a time: another source is only taken up on a keyframe, once the current one has gone quiet
+  if (from != source && (live(nowMs) || !keyframe)) return STREAM_REJECTED;
+
+  if (msg.fragments == 0 || msg.fragments > STREAM_MAX_FRAGMENTS || msg.fragment >= msg.fragments ||
+    msg.frameSize == 0 || msg.frameSize > STREAM_MAX_ENCODED) {
+    return STREAM_REJECTED;
+  }
+
+  if (from != source || msg.frame != assembling || assemblingPieces == 0) {
+    // a piece of a frame older than one we've got, overtaken on the way.  Once the source has gone quiet, its frame
+    // numbers may have started over (a reboot), and a keyframe starts the stream again from wherever they are.
+    if (from == source && live(nowMs) && (int16_t)(msg.frame - shownFrame) <= 0) return STREAM_REJECTED;
+
+    if (assemblingPieces != 0) counters.incomplete++;
+
+    source = from;
+    assembling = msg.frame;
+    assemblingBase = msg.base;
+    assemblingSize = msg.frameSize;
+    assemblingPieces = msg.fragments;
+    memset(received, 0, sizeof(received));
+  }
+
+  size_t offset = (size_t)msg.fragment * MESSAGE_MAX_DATA;
+  size_t expected = assemblingSize - offset < MESSAGE_MAX_DATA ? assemblingSize - offset : MESSAGE_MAX_DATA;
+
+  if (offset >= assemblingSize || decodeData(msg, assembly + offset, expected) != expected) return STREAM_REJECTED;
+
+  received[msg.fragment / 8] |= 1 << (msg.fragment % 8);
+
+  for (uint8_t i = 0; i < assemblingPieces; i++) {
+    if (!(received[i / 8] & (1 << (i % 8)))) return STREAM_PENDING;
+  }
+
+  // all there
+  bool delta = assemblingBase != assembling;
+  assemblingPieces = 0;
+
+  if (delta && (!hasFrame || shownFrame != assemblingBase)) {
+    counters.missingBase++;
+    return STREAM_NEED_KEYFRAME;
+  }
+
+  uint16_t count = rleDecode(assembly, assemblingSize, pixels, NUM_LEDS, delta);
+  if (count == 0) return STREAM_REJECTED;
+
+  pixelCount = count < NUM_LEDS ? count : NUM_LEDS;
+  hasFrame = true;
+  shownFrame = assembling;
+  lastFrameMs = nowMs;
+  counters.applied++;
+  return STREAM_FRAME;
+}
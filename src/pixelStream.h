@@ -0,0 +1,114 @@
+/*
+ *  Pixel streaming.
+ *
+ *  Lets one node (the controller with STREAM_FROM_CONTROLLER, or a host bridge calling streamPixels()) send the others
+ *  whole frames for leds[], so a mesh can show content none of its nodes were flashed with.  Each frame is run-length
+ *  encoded (below), either as it is (a keyframe) or XORed with the frame sent before it (a delta, mostly zeros when
+ *  little changed), and goes out as MSG_PIXELS pieces of up to MESSAGE_MAX_DATA bytes.  A receiver puts the pieces
+ *  back together and shows the frame once it has all of them and, for a delta, the frame it applies to.  One that's
+ *  missing that base asks the sender for a keyframe (MSG_STREAM_NACK).  While frames keep arriving they replace the
+ *  receiver's own animation; STREAM_TIMEOUT_MS after the last one it goes back to it.
+ *
+ *  The sender governs its own rate.  A token bucket holds STREAM_AIRTIME_BUDGET bytes per second on air (every piece
+ *  is flooded to every node) and frames that don't fit are skipped.  A keyframe goes out at least every
+ *  STREAM_KEYFRAME_MS, so late joiners pick the stream up.  A NACK, or a piece the outbox had to drop, means the link
+ *  isn't keeping up: for STREAM_DEGRADED_MS after one it sends keyframes only, which don't depend on anything else
+ *  having arrived, and the bucket makes them less frequent.
+ *
+ *  Run encoding, in whole pixels: a control byte c, then
+ *    c < 128:   c + 1 pixels as they are
+ *    c >= 128:  c - 126 copies (2..129) of the one pixel that follows
+ *
+ *  This header needs NUM_LEDS, so meshLights.h includes it after the LED setup.
+ */
+
+#ifndef PIXELSTREAM_H
+#define PIXELSTREAM_H
+
+#include <FastLED.h>
+#include "protocol.h"
+
+#define STREAM_FRAME_MS          40       // num milliseconds between frames the controller streams
+#define STREAM_KEYFRAME_MS       2000     // num milliseconds between keyframes, at most
+#define STREAM_DEGRADED_MS       5000     // num milliseconds of keyframes only after the link falls behind
+#define STREAM_TIMEOUT_MS        1000     // num milliseconds without a frame before a receiver goes back to its own animation
+#define STREAM_NACK_DELAY        500      // num milliseconds a receiver waits before asking for another keyframe
+#define STREAM_AIRTIME_BUDGET    40000    // bytes per second of stream, summed over every node in the mesh
+#define STREAM_PIECE_OVERHEAD    72       // bytes on air for one MSG_PIXELS besides its data: header, Z85, painlessMesh's package
+
+#define STREAM_MAX_ENCODED       (NUM_LEDS * 3 + (NUM_LEDS + 127) / 128)   // a frame that doesn't compress at all
+#define STREAM_MAX_FRAGMENTS     ((STREAM_MAX_ENCODED + MESSAGE_MAX_DATA - 1) / MESSAGE_MAX_DATA)
+
+// run-length encode count pixels, XORed with base if there is one.  Returns the encoded size, 0 if it didn't fit.
+size_t rleEncode(const CRGB *pixels, const CRGB *base, uint16_t count, uint8_t *out, size_t capacity);
+
+// decode into pixels (XORing into what's there for a delta), writing at most capacity of them.  Returns the number of
+// pixels in the frame, 0 if it's malformed, in which case pixels haven't been touched.
+uint16_t rleDecode(const uint8_t *in, size_t length, CRGB *pixels, uint16_t capacity, bool delta);
+
+enum StreamResult {
+  STREAM_PENDING,                         // more pieces to come
+  STREAM_FRAME,                           // a new frame is in pixels[]
+  STREAM_NEED_KEYFRAME,                   // a delta arrived for a frame we don't have
+  STREAM_REJECTED                         // not from the stream we're showing, or unreadable
+};
+
+struct StreamCounters {
+  uint32_t keyframes;                     // sent
+  uint32_t deltas;
+  uint32_t skipped;                       // frames the budget didn't have room for
+  uint32_t applied;                       // received and shown
+  uint32_t incomplete;                    // given up on, for a newer frame, with pieces missing
+  uint32_t missingBase;                   // deltas for a frame we didn't have
+  uint32_t nacks;                         // sent by a receiver, heard by a sender
+};
+
+class PixelStream {
+public:
+  PixelStream() { reset(); }
+  void reset();
+
+  // sending: encode the next frame into encoded[] (frame, base and size say what it is), or return 0 to skip it.  Its
+  // pieces are then queued a few at a time, as the outbox has room (nextPiece of pieces).
+  size_t encode(const CRGB *pixels, uint16_t count, uint32_t nowMs, uint32_t nodes);
+  void degrade(uint32_t nowMs);           // the link isn't keeping up: keyframes only for a while
+
+  // receiving: one MSG_PIXELS
+  StreamResult receive(uint32_t from, const Message &msg, uint32_t nowMs);
+  bool live(uint32_t nowMs) const { return hasFrame && nowMs - lastFrameMs < STREAM_TIMEOUT_MS; }
+
+  StreamCounters counters;
+
+  // sender
+  uint16_t frame;                         // number of the frame in encoded[]
+  uint16_t base;                          // the frame it's a delta on, or frame for a keyframe
+  uint16_t size;
+  uint8_t encoded[STREAM_MAX_ENCODED];
+  uint8_t pieces;
+  uint8_t nextPiece;                      // the next one to queue
+  uint32_t dropsSeen;                     // the outbox's count of stream pieces it dropped, as of the last look
+  CRGB sent[NUM_LEDS];                    // the last frame sent, what the next delta is on
+  uint16_t sentCount;
+  int32_t tokens;                         // bytes on air the budget has left, below 0 when a big frame overdrew it
+  uint32_t lastEncodeMs;
+  uint32_t lastKeyframeMs;
+  uint32_t degradedUntilMs;
+
+  // receiver
+  CRGB pixels[NUM_LEDS];                  // the last complete frame
+  uint16_t pixelCount;
+  bool hasFrame;
+  uint16_t shownFrame;
+  uint32_t lastFrameMs;
+  uint32_t source;                        // node the frames come from
+  uint32_t lastNackMs;
+
+  uint16_t assembling;                    // frame being put back together
+  uint16_t assemblingBase;
+  uint16_t assemblingSize;
+  uint8_t assemblingPieces;
+  uint8_t received[(STREAM_MAX_FRAGMENTS + 7) / 8];   // which pieces are in, a bit each
+  uint8_t assembly[STREAM_MAX_ENCODED];
+};
+
+#endif
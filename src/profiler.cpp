@@ -0,0 +1,103 @@
+#include "meshLights.h"
+#include "profiler.h"
+
+#ifdef PROFILE_LOOP
+
+#define PROFILE_BUCKETS 64
+
+struct PhaseHistogram {
+  uint32_t buckets[PROFILE_BUCKETS];
+  uint32_t count;
+  uint32_t max;
+};
+
+static const char *phaseNames[NUM_PHASES] = { "loop", "mesh.update", "animation", "show", "shiftHue", "election", "sendMessage", "outbox", "frame" };
+
+static PhaseHistogram histograms[NUM_PHASES];
+static uint32_t lastFrameStart = 0;
+static uint32_t meshCyclesThisFrame = 0;     // time spent in mesh.update() since the last frame started
+static uint32_t lateFrames = 0;
+static uint32_t lateFramesFromMesh = 0;      // late frames where mesh.update() ate more than half the frame
+
+static CEveryNSeconds reportTimer(PROFILE_REPORT_SECONDS);
+
+// two buckets per power of two: [2^n, 1.5*2^n) and [1.5*2^n, 2^(n+1))
+static uint8_t bucketOf(uint32_t cycles) {
+  if (cycles < 2) return cycles;
+
+  uint8_t msb = 31 - __builtin_clz(cycles);
+  return msb * 2 + ((cycles >> (msb - 1)) & 1);
+}
+
+static uint32_t bucketLimit(uint8_t bucket) {
+  uint8_t next = bucket + 1;
+  if (next < 2) return next;
+  if (next >= PROFILE_BUCKETS) return 0xFFFFFFFF;
+
+  uint32_t base = 1UL << (next / 2);
+  return (next & 1) ? base + base / 2 : base;
+}
+
+void profileRecord(LoopPhase phase, uint32_t cycles) {
+  PhaseHistogram &h = histograms[phase];
+
+  h.buckets[bucketOf(cycles)]++;
+  h.count++;
+  if (cycles > h.max) h.max = cycles;
+
+  if (phase == PHASE_MESH_UPDATE) meshCyclesThisFrame += cycles;
+}
+
+void profileFrame(uint32_t now) {
+  uint32_t interval = now - lastFrameStart;
+  bool first = lastFrameStart == 0;
+
+  lastFrameStart = now;
+  if (first) return;
+
+  profileRecord(PHASE_FRAME, interval);
+
+  if (interval > PROFILE_FRAME_BUDGET_MS * 1000UL * localClock->cyclesPerMicro()) {
+    lateFrames++;
+    if (meshCyclesThisFrame > interval / 2) lateFramesFromMesh++;
+  }
+
+  meshCyclesThisFrame = 0;
+}
+
+// upper edge of the bucket holding the given rank, capped at the largest value seen
+static uint32_t percentile(const PhaseHistogram &h, uint8_t percent) {
+  uint32_t rank = ((uint64_t)h.count * percent + 99) / 100;
+  uint32_t seen = 0;
+
+  for (uint8_t b = 0; b < PROFILE_BUCKETS; b++) {
+    seen += h.buckets[b];
+    if (seen >= rank) return bucketLimit(b) < h.max ? bucketLimit(b) : h.max;
+  }
+
+  return h.max;
+}
+
+void profileReportIfDue() {
+  if (!reportTimer) return;
+
+  float perMicro = localClock->cyclesPerMicro();
+
+  Serial.printf("\n>> LOOP PROFILE: last %d s, %u frames, %u late (> %d ms), %u of them during a mesh.update() spike\n",
+    PROFILE_REPORT_SECONDS, histograms[PHASE_FRAME].count, lateFrames, PROFILE_FRAME_BUDGET_MS, lateFramesFromMesh);
+  Serial.printf("   %-12s %8s %10s %10s %10s\n", "phase", "count", "p50 us", "p99 us", "max us");
+
+  for (uint8_t p = 0; p < NUM_PHASES; p++) {
+    const PhaseHistogram &h = histograms[p];
+    if (h.count == 0) continue;
+
+    Serial.printf("   %-12s %8u %10.1f %10.1f %10.1f\n", phaseNames[p], h.count,
+      percentile(h, 50) / perMicro, percentile(h, 99) / perMicro, h.max / perMicro);
+  }
+
+  memset(histograms, 0, sizeof(histograms));
+  lateFrames = 0;
+  lateFramesFromMesh = 0;
+}
+
+#endif
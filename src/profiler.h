@@ -0,0 +1,54 @@
+/*
+ *  Loop profiler.
+ *
+ *  Build with -D PROFILE_LOOP to time each phase of stepLoop() with the cycle counter (localClock->cycles()) and keep
+ *  a log-bucketed histogram per phase (two buckets per power of two).  Every PROFILE_REPORT_SECONDS a summary (count,
+ *  p50, p99, max) is printed and the histograms start over.  Without PROFILE_LOOP the macros compile to nothing.
+ *
+ *  Phases nest: LOOP contains everything, ANIMATION contains SHOW, and MESH_UPDATE contains every receive callback
+ *  painlessMesh dispatches from inside mesh.update().  FRAME is the time between the starts of consecutive show()s.
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <Arduino.h>
+#include "hal.h"
+
+#define PROFILE_REPORT_SECONDS  10           // num seconds between profile summaries
+#define PROFILE_FRAME_BUDGET_MS HUE_DELAY    // a frame that takes longer than this misses a hue step and counts as late
+
+enum LoopPhase {
+  PHASE_LOOP,
+  PHASE_MESH_UPDATE,
+  PHASE_ANIMATION,
+  PHASE_SHOW,
+  PHASE_HUE,
+  PHASE_ELECTION,
+  PHASE_MESSAGE,
+  PHASE_OUTBOX,
+  PHASE_FRAME,
+  NUM_PHASES
+};
+
+#ifdef PROFILE_LOOP
+
+#define PROFILE_BEGIN(phase)  uint32_t profileStart_##phase = localClock->cycles()
+#define PROFILE_END(phase)    profileRecord(phase, localClock->cycles() - profileStart_##phase)
+#define PROFILE_FRAME()       profileFrame(localClock->cycles())
+#define PROFILE_REPORT()      profileReportIfDue()
+
+void profileRecord(LoopPhase phase, uint32_t cycles);
+void profileFrame(uint32_t now);
+void profileReportIfDue();
+
+#else
+
+#define PROFILE_BEGIN(phase)
+#define PROFILE_END(phase)
+#define PROFILE_FRAME()
+#define PROFILE_REPORT()
+
+#endif
+
+#endif
@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "protocol.h"
+#include "binstream.h"
+
+static size_t payloadSize(uint8_t type) {
+  switch (type) {
+    case MSG_KEYFRAME: return 0;
+    case MSG_DISPLAY_MODE: return 1;
+    case MSG_BEACON: return 8;
+    case MSG_SYNC_REQUEST: return 0;
+    case MSG_SYNC: return 9;
+    case MSG_PIXELS: return 8;
+    case MSG_STREAM_NACK: return 2;
+    case MSG_PING: return 4;
+    case MSG_PONG: return 4;
+    case MSG_COMMAND: return 10;
+    default: return 0;
+  }
+}
+
+// fields added to a type since it was first sent, at the end, which older firmware leaves out
+static size_t optionalSize(uint8_t type) {
+  switch (type) {
+    case MSG_BEACON: return 6;
+    case MSG_SYNC: return 6;
+    default: return 0;
+  }
+}
+
+size_t encodeMessage(const Message &msg, char *text, size_t capacity) {
+  uint8_t frame[MESSAGE_MAX_SIZE];
+  BinWriter w(frame, sizeof(frame));
+
+  w.put8(PROTOCOL_VERSION);
+  w.put8(msg.type);
+  w.put16(msg.seq);
+  w.put64(msg.timestamp);
+
+  switch (msg.type) {
+    case MSG_DISPLAY_MODE:
+      w.put8(msg.mode);
+      break;
+    case MSG_BEACON:
+    case MSG_SYNC:
+      w.put8(msg.mode);
+      w.put8(msg.hue);
+      w.put32(msg.controller);
+      w.put16(msg.epoch);
+      if (msg.type == MSG_SYNC) w.put8(msg.hueElapsed);
+      w.put32(msg.hueOrigin);
+      w.put16(msg.hueFraction);
+      break;
+    case MSG_PIXELS:
+      w.put16(msg.frame);
+      w.put16(msg.base);
+      w.put8(msg.fragment);
+      w.put8(msg.fragments);
+      w.put16(msg.frameSize);
+      w.putBytes(msg.data, msg.dataSize);
+      break;
+    case MSG_STREAM_NACK:
+      w.put16(msg.frame);
+      break;
+    case MSG_PING:
+    case MSG_PONG:
+      w.put32(msg.probe);
+      break;
+    case MSG_COMMAND:
+      w.put8(msg.command);
+      w.put8(msg.argument);
+      w.put64(msg.at);
+      break;
+  }
+
+  size_t length = 1 + Z85_ENCODED_SIZE(w.length);
+  if (w.overflow || length + 1 > capacity) return 0;
+
+  text[0] = PROTOCOL_MARKER;
+  z85Encode(frame, w.length, text + 1);
+  text[length] = '\0';
+  return length;
+}
+
+size_t encodeLegacyMessage(const Message &msg, char *text, size_t capacity) {
+  int length;
+
+  if (msg.type == MSG_KEYFRAME) {
+    length = snprintf(text, capacity, "{\"msg\":\"KEYFRAME\",\"timestamp\":%u}", (uint32_t)msg.timestamp);
+  }
+  else if (msg.type == MSG_DISPLAY_MODE) {
+    length = snprintf(text, capacity, "{\"msg\":%u,\"timestamp\":%u}", msg.mode, (uint32_t)msg.timestamp);
+  }
+  else {
+    return 0;                             // the old firmware doesn't have anything else, and would read it as a mode
+  }
+
+  return length > 0 && (size_t)length < capacity ? length : 0;
+}
+
+// where the value of "key" starts in a flat JSON object, or nullptr.  Good enough for the messages the old firmware
+// sends: no nesting, no escaped quotes.
+static const char *findValue(const char *text, const char *end, const char *key) {
+  size_t keyLength = strlen(key);
+
+  for (const char *at = text; at + keyLength + 2 < end; at++) {
+    if (*at != '"' || at[keyLength + 1] != '"' || memcmp(at + 1, key, keyLength) != 0) continue;
+
+    const char *value = at + keyLength + 2;
+    while (value < end && *value == ' ') value++;
+    if (value == end || *value++ != ':') continue;
+    while (value < end && *value == ' ') value++;
+
+    return value < end ? value : nullptr;
+  }
+
+  return nullptr;
+}
+
+// digits up to the first non-digit; false if there aren't any
+static bool parseNumber(const char *at, const char *end, uint64_t &value) {
+  const char *start = at;
+
+  value = 0;
+  while (at < end && *at >= '0' && *at <= '9') value = value * 10 + (*at++ - '0');
+  return at > start;
+}
+
+// reads the old JSON messages where they lie, without a JSON library or a copy
+static bool decodeLegacy(const char *text, size_t length, Message &msg) {
+  const char *end = text + length;
+  const char *body = findValue(text, end, "msg");
+  const char *timestamp = findValue(text, end, "timestamp");
+  uint64_t number;
+
+  if (!body) return false;
+
+  msg.legacy = true;
+  msg.seq = 0;
+  msg.timestamp = timestamp && parseNumber(timestamp, end, number) ? (uint32_t)number : 0;
+
+  if (end - body >= 10 && memcmp(body, "\"KEYFRAME\"", 10) == 0) {
+    msg.type = MSG_KEYFRAME;
+    return true;
+  }
+
+  // the mode is sent as a number, but the old firmware read it with toInt(), so a quoted one worked too
+  if (*body == '"') body++;
+  if (!parseNumber(body, end, number)) return false;
+
+  msg.type = MSG_DISPLAY_MODE;
+  msg.mode = number;
+  return true;
+}
+
+// the header is a whole number of Z85 groups, so header and payload decode separately
+static_assert(MESSAGE_HEADER_SIZE % 4 == 0, "message header must be a multiple of 4 bytes");
+
+#define HEADER_TEXT_SIZE (1 + Z85_ENCODED_SIZE(MESSAGE_HEADER_SIZE))
+#define PAYLOAD_FIXED_SIZE 16                   // the biggest payloadSize() and optionalSize(), rounded up to whole groups
+
+bool decodeHeader(const char *text, size_t length, Message &msg) {
+  if (length == 0) return false;
+  if (text[0] == '{') return decodeLegacy(text, length, msg);
+  if (text[0] != PROTOCOL_MARKER || length < HEADER_TEXT_SIZE) return false;
+
+  uint8_t header[MESSAGE_HEADER_SIZE];
+  if (!z85Decode(text + 1, HEADER_TEXT_SIZE - 1, header)) return false;
+
+  BinReader r(header, sizeof(header));
+  if (r.get8() != PROTOCOL_VERSION) return false;
+
+  msg.legacy = false;
+  msg.type = r.get8();
+  msg.seq = r.get16();
+  msg.timestamp = r.get64();
+  return true;
+}
+
+bool decodePayload(const char *text, size_t length, Message &msg) {
+  if (msg.legacy) return true;                  // decodeHeader() already read all of it
+
+  uint8_t payload[PAYLOAD_FIXED_SIZE];
+  size_t chars = length - HEADER_TEXT_SIZE;
+  size_t size = Z85_DECODED_SIZE(chars);
+
+  // only the fixed fields are decoded, a whole number of groups of them.  Anything after is fields from a later
+  // version, or pixel data, which is left where it is for decodeData().
+  size_t fixed = (payloadSize(msg.type) + optionalSize(msg.type) + 3) & ~3;
+  if (size > fixed) {
+    size = fixed;
+    chars = Z85_ENCODED_SIZE(size);
+  }
+
+  if (size < payloadSize(msg.type) || !z85Decode(text + HEADER_TEXT_SIZE, chars, payload)) return false;
+
+  BinReader r(payload, size);
+
+  switch (msg.type) {
+    case MSG_KEYFRAME: break;
+    case MSG_DISPLAY_MODE: msg.mode = r.get8(); break;
+    case MSG_SYNC_REQUEST: break;
+    case MSG_BEACON:
+    case MSG_SYNC:
+      msg.mode = r.get8();
+      msg.hue = r.get8();
+      msg.controller = r.get32();
+      msg.epoch = r.get16();
+      if (msg.type == MSG_SYNC) msg.hueElapsed = r.get8();
+      msg.hasHueOrigin = size >= payloadSize(msg.type) + 4;
+      msg.hueOrigin = msg.hasHueOrigin ? r.get32() : 0;
+      msg.hasHueFraction = size >= payloadSize(msg.type) + 6;
+      msg.hueFraction = msg.hasHueFraction ? r.get16() : 0;
+      break;
+    case MSG_PIXELS:
+      msg.frame = r.get16();
+      msg.base = r.get16();
+      msg.fragment = r.get8();
+      msg.fragments = r.get8();
+      msg.frameSize = r.get16();
+      msg.dataText = text + HEADER_TEXT_SIZE + chars;
+      msg.dataTextLength = length - HEADER_TEXT_SIZE - chars;
+      break;
+    case MSG_STREAM_NACK:
+      msg.frame = r.get16();
+      break;
+    case MSG_PING:
+    case MSG_PONG:
+      msg.probe = r.get32();
+      break;
+    case MSG_COMMAND:
+      msg.command = r.get8();
+      msg.argument = r.get8();
+      msg.at = r.get64();
+      break;
+    default: return false;
+  }
+
+  return true;
+}
+
+size_t decodeData(const Message &msg, uint8_t *data, size_t capacity) {
+  size_t size = Z85_DECODED_SIZE(msg.dataTextLength);
+
+  if (size == 0 || size > capacity || !z85Decode(msg.dataText, msg.dataTextLength, data)) return 0;
+  return size;
+}
+
+bool decodeMessage(const char *text, size_t length, Message &msg) {
+  return decodeHeader(text, length, msg) && decodePayload(text, length, msg);
+}
@@ -0,0 +1,122 @@
+/*
+ *  Mesh message format.
+ *
+ *  Every message is a small fixed-layout binary frame, little-endian:
+ *
+ *    u8 version, u8 type, u16 sequence number (per sender), u64 mesh timestamp (microseconds), then the payload for
+ *    the type:
+ *      MSG_BEACON:        u8 mode, u8 gHue, u32 controller ID, u16 election epoch, u32 hue origin, u16 hue fraction
+ *      MSG_KEYFRAME:      nothing
+ *      MSG_DISPLAY_MODE:  u8 mode
+ *      MSG_SYNC_REQUEST:  nothing
+ *      MSG_SYNC:          as MSG_BEACON up to the epoch, u8 milliseconds since the sender's gHue last stepped,
+ *                         u32 hue origin, u16 hue fraction
+ *      MSG_PIXELS:        u16 frame, u16 base frame, u8 fragment, u8 fragments, u16 encoded frame size, then up to
+ *                         MESSAGE_MAX_DATA bytes of the encoded frame
+ *      MSG_STREAM_NACK:   u16 frame
+ *      MSG_PING:          u32 the sender's micros() when it sent it
+ *      MSG_PONG:          u32 the same, back
+ *      MSG_COMMAND:       u8 command, u8 argument, u64 mesh time to run it at
+ *
+ *  The controller sends a beacon every few seconds (see beaconRate.h): everything a node needs to follow it, as of
+ *  the one timestamp.  KEYFRAME and displayMode are what it sent before beacons existed, and what it still sends with
+ *  SEND_LEGACY_JSON; they're still read, from firmware that hasn't been upgraded yet.  A node that finds itself out
+ *  of step sends the controller a sync request, and gets a sync back, unicast, with the phase to the millisecond.
+ *  MSG_PIXELS and MSG_STREAM_NACK carry streamed pixel frames, see pixelStream.h.  MSG_PING and MSG_PONG time the
+ *  round trip to the controller, see latency.h.  MSG_COMMAND is a command for every node to run at the same mesh time,
+ *  see commands.h.
+ *
+ *  painlessMesh only carries Strings, so the frame travels as PROTOCOL_MARKER followed by its Z85 encoding (z85.h):
+ *  34 characters for a beacon, 16 for a keyframe, 18 for a display mode.  The old JSON messages
+ *  ({"msg":"KEYFRAME","timestamp":...} and {"msg":<mode>,"timestamp":...}) start with '{' instead of the marker, so
+ *  decodeMessage() still reads them, with a small in-place scanner rather than a JSON library.  They come back with
+ *  legacy set, sequence number 0 and a 32-bit timestamp.  Set SEND_LEGACY_JSON to keep sending them while a mesh is
+ *  being upgraded.
+ *
+ *  Bytes after the payload are ignored, so a message can grow new fields at the end without a version bump.  The hue
+ *  origin came that way: a beacon or sync without it still decodes, with hasHueOrigin false.  So did the hue fraction
+ *  (how far into its hue step the sender was, see huePhase.h), with hasHueFraction.
+ */
+
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "z85.h"
+
+#define PROTOCOL_VERSION     1
+#define PROTOCOL_MARKER      '~'          // outside the Z85 set, and not '{'
+#define MESSAGE_HEADER_SIZE  12
+#define MESSAGE_MAX_DATA     128          // bytes of pixel data in one MSG_PIXELS
+#define MESSAGE_MAX_SIZE     (MESSAGE_HEADER_SIZE + 8 + MESSAGE_MAX_DATA)   // bytes, header and payload
+#define MESSAGE_MAX_TEXT     (1 + Z85_ENCODED_SIZE(MESSAGE_MAX_SIZE) + 1)   // marker, Z85, terminator
+
+enum MessageType {
+  MSG_KEYFRAME = 1,
+  MSG_DISPLAY_MODE,
+  MSG_BEACON,
+  MSG_SYNC_REQUEST,
+  MSG_SYNC,
+  MSG_PIXELS,
+  MSG_STREAM_NACK,
+  MSG_PING,
+  MSG_PONG,
+  MSG_COMMAND,
+  NUM_MESSAGE_TYPES
+};
+
+struct Message {
+  uint8_t type;
+  uint16_t seq;
+  uint64_t timestamp;                     // sender's mesh time when it was sent, microseconds
+  bool legacy;                            // arrived as old-style JSON
+
+  uint8_t mode;                           // MSG_DISPLAY_MODE, MSG_BEACON, MSG_SYNC
+  uint8_t hue;                            // MSG_BEACON, MSG_SYNC: the sender's gHue at timestamp
+  uint32_t controller;                    // MSG_BEACON, MSG_SYNC: who the sender thinks is controller
+  uint16_t epoch;                         // MSG_BEACON, MSG_SYNC: the sender's election epoch
+  uint8_t hueElapsed;                     // MSG_SYNC: milliseconds since the sender's gHue last stepped
+  uint32_t hueOrigin;                     // MSG_BEACON, MSG_SYNC: where the sender's hue timeline starts, see HUE_TIMELINE
+  bool hasHueOrigin;                      //   false from firmware that doesn't send it
+  uint16_t hueFraction;                   // MSG_BEACON, MSG_SYNC: how far into the hue step, in 65536ths
+  bool hasHueFraction;                    //   false from firmware that doesn't send it
+
+  uint16_t frame;                         // MSG_PIXELS, MSG_STREAM_NACK
+  uint16_t base;                          // MSG_PIXELS: the frame a delta applies to, the frame itself for a keyframe
+  uint8_t fragment;                       // MSG_PIXELS: which piece of the encoded frame this is
+  uint8_t fragments;                      //   out of how many
+  uint16_t frameSize;                     //   and how big the whole encoded frame is
+  const uint8_t *data;                    // MSG_PIXELS, to send: this piece
+  uint16_t dataSize;
+  const char *dataText;                   // MSG_PIXELS, received: this piece, still as Z85 text (see decodeData())
+  uint16_t dataTextLength;
+
+  uint32_t probe;                         // MSG_PING, MSG_PONG: the pinging node's micros() when it sent the ping
+
+  uint8_t command;                        // MSG_COMMAND: a CommandType
+  uint8_t argument;
+  uint64_t at;                            //   mesh time to run it at
+};
+
+// writes the marker, the Z85 text and a terminator; returns the length without the terminator, 0 if it didn't fit
+size_t encodeMessage(const Message &msg, char *text, size_t capacity);
+
+// the old JSON form of the same message, for meshes that still have old firmware on them.  Only KEYFRAME and
+// DISPLAY_MODE have one; anything else is 0.
+size_t encodeLegacyMessage(const Message &msg, char *text, size_t capacity);
+
+// either form, straight from the received text: no heap, no Strings.  Returns false for anything it can't make sense
+// of, including frames from another protocol version.
+bool decodeMessage(const char *text, size_t length, Message &msg);
+
+// the same in two steps, so a message can be looked at (and dropped) on its header alone: version, type, sequence
+// number and timestamp.  A legacy message is read in full by decodeHeader().
+bool decodeHeader(const char *text, size_t length, Message &msg);
+bool decodePayload(const char *text, size_t length, Message &msg);
+
+// the data in a received MSG_PIXELS, which decodePayload() leaves where it is.  Returns its size, 0 if it's unreadable
+// or bigger than capacity.
+size_t decodeData(const Message &msg, uint8_t *data, size_t capacity);
+
+#endif
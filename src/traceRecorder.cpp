@@ -0,0 +1,144 @@
+#include "meshLights.h"
+#include "traceRecorder.h"
+#include "binstream.h"
+
+#ifdef RECORD_TRACE
+
+static TraceOutput *traceOutput = nullptr;
+static bool traceActive = true;
+static uint8_t traceBuffer[TRACE_BUFFER_SIZE];
+static size_t traceLength = 0;
+static uint32_t traceBytes = 0;           // written to the output so far
+static uint32_t lastMicros = 0;
+static int32_t lastOffset = 0;            // mesh time - local time, as of the previous record
+
+static CEveryNSeconds traceFlushTimer(TRACE_FLUSH_SECONDS);
+
+static void traceWrite() {
+  if (traceLength == 0) return;
+
+  if (traceBytes + traceLength <= TRACE_MAX_BYTES) {
+    traceOutput->write(traceBuffer, traceLength);
+    traceBytes += traceLength;
+  }
+  else {
+    Serial.printf("!! TRACE: reached %u bytes, recording stopped\n", traceBytes);
+    traceOutput = nullptr;
+  }
+
+  traceLength = 0;
+}
+
+// copies into the buffer, writing it out as often as it fills
+static void traceAppend(const uint8_t *data, size_t length) {
+  while (length > 0 && traceOutput) {
+    size_t chunk = TRACE_BUFFER_SIZE - traceLength;
+    if (chunk > length) chunk = length;
+
+    memcpy(traceBuffer + traceLength, data, chunk);
+    traceLength += chunk;
+    data += chunk;
+    length -= chunk;
+
+    if (traceLength == TRACE_BUFFER_SIZE) traceWrite();
+  }
+}
+
+static bool recording() {
+  return traceOutput && traceActive;
+}
+
+// type and both clocks, common to every record
+static void recordHead(BinWriter &w, TraceRecordType type) {
+  uint32_t now = localClock->micros();
+  int32_t offset = meshTransport->getNodeTime() - now;
+
+  w.put8(type);
+  w.putVarint(now - lastMicros);
+  w.putSigned((int64_t)offset - lastOffset);
+
+  lastMicros = now;
+  lastOffset = offset;
+}
+
+void traceBegin(TraceOutput *output, uint32_t nodeId) {
+  uint8_t header[9];
+  BinWriter w(header, sizeof(header));
+
+  w.putBytes("MLTR", 4);
+  w.put8(TRACE_VERSION);
+  w.put32(nodeId);
+
+  traceOutput = output;
+  traceLength = 0;
+  traceBytes = 0;
+  lastMicros = 0;
+  lastOffset = 0;
+  traceAppend(header, w.length);
+}
+
+void traceEnd() {
+  if (!traceOutput) return;
+
+  traceWrite();
+  if (traceOutput) traceOutput->flush();
+  traceOutput = nullptr;
+}
+
+void traceSetActive(bool active) {
+  traceActive = active;
+}
+
+void traceReceived(uint32_t from, const String &msg) {
+  if (!recording()) return;
+
+  uint8_t head[24];
+  BinWriter w(head, sizeof(head));
+
+  recordHead(w, TRACE_RECEIVED);
+  w.put32(from);
+  w.putVarint(msg.length());
+
+  traceAppend(head, w.length);
+  traceAppend((const uint8_t *)msg.c_str(), msg.length());
+}
+
+void traceChanged() {
+  if (!recording()) return;
+
+  SimpleList<uint32_t> nodes = meshTransport->getNodeList();
+  uint8_t head[24];
+  BinWriter w(head, sizeof(head));
+
+  recordHead(w, TRACE_CHANGED);
+  w.putVarint(nodes.size());
+  traceAppend(head, w.length);
+
+  for (SimpleList<uint32_t>::iterator node = nodes.begin(); node != nodes.end(); ++node) {
+    uint8_t id[4];
+    BinWriter n(id, sizeof(id));
+
+    n.put32(*node);
+    traceAppend(id, n.length);
+  }
+}
+
+void traceTimeAdjusted(int32_t offset) {
+  if (!recording()) return;
+
+  uint8_t head[32];
+  BinWriter w(head, sizeof(head));
+
+  recordHead(w, TRACE_TIME_ADJUSTED);
+  w.putSigned(offset);
+  traceAppend(head, w.length);
+}
+
+void traceFlushIfDue() {
+  if (!traceFlushTimer || !traceOutput) return;
+
+  traceWrite();
+  if (traceOutput) traceOutput->flush();
+}
+
+#endif
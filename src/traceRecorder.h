@@ -0,0 +1,70 @@
+/*
+ *  Mesh traffic recorder.
+ *
+ *  Build with -D RECORD_TRACE to log every receivedCallback(), changedConnectionCallback() and
+ *  nodeTimeAdjustedCallback() to a compact binary trace, along with the local time it happened and the mesh time the
+ *  node saw.  The replay tool (src/host/replay) feeds a trace back through the same logic on a workstation.  Without
+ *  RECORD_TRACE the macros compile to nothing.
+ *
+ *  Records are buffered in RAM and handed to the TraceOutput when the buffer fills up, and every TRACE_FLUSH_SECONDS.
+ *
+ *  Format (see binstream.h for the encodings):
+ *
+ *    header:  "MLTR", u8 version, u32 node ID
+ *    record:  u8 type, varint local microseconds since the previous record (since boot for the first),
+ *             signed varint change in (mesh time - local time) since the previous record, then
+ *      TRACE_RECEIVED:       u32 from, varint length, message bytes
+ *      TRACE_CHANGED:        varint count, u32 node ID x count -- getNodeList() as it stood, orphan 0s and all
+ *      TRACE_TIME_ADJUSTED:  signed varint offset
+ */
+
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <Arduino.h>
+
+#define TRACE_VERSION        1
+#define TRACE_BUFFER_SIZE    2048         // bytes held in RAM between writes
+#define TRACE_FLUSH_SECONDS  5            // num seconds between forced writes
+#define TRACE_MAX_BYTES      1048576      // recording stops once a trace gets this big (ESP32 flash)
+
+enum TraceRecordType {
+  TRACE_RECEIVED = 1,
+  TRACE_CHANGED,
+  TRACE_TIME_ADJUSTED
+};
+
+// where trace bytes end up: a flash file on the ESP32, a FILE* on the host
+class TraceOutput {
+public:
+  virtual ~TraceOutput() {}
+  virtual void write(const uint8_t *data, size_t length) = 0;
+  virtual void flush() {}
+};
+
+#ifdef RECORD_TRACE
+
+#define TRACE_RECEIVED(from, msg)     traceReceived(from, msg)
+#define TRACE_CHANGED()               traceChanged()
+#define TRACE_TIME_ADJUSTED(offset)   traceTimeAdjusted(offset)
+#define TRACE_FLUSH()                 traceFlushIfDue()
+
+void traceBegin(TraceOutput *output, uint32_t nodeId);
+void traceEnd();                          // flushes, and stops recording
+void traceSetActive(bool active);         // the simulator only records the node it was asked to
+
+void traceReceived(uint32_t from, const String &msg);
+void traceChanged();
+void traceTimeAdjusted(int32_t offset);
+void traceFlushIfDue();
+
+#else
+
+#define TRACE_RECEIVED(from, msg)
+#define TRACE_CHANGED()
+#define TRACE_TIME_ADJUSTED(offset)
+#define TRACE_FLUSH()
+
+#endif
+
+#endif
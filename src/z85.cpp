@@ -0,0 +1,101 @@
+#include "z85.h"
+
+static const char encoder[86] =
+  "0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ.-:+=^!/*?&<>()[]{}@%$#";
+
+// indexed by the character itself, so there's no range check: 0xFF for anything outside the set.  Every digit is
+// below 0x80, which lets a whole group be checked with one test.
+static const uint8_t decoder[256] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0x44, 0xFF, 0x54, 0x53, 0x52, 0x48, 0xFF, 0x4B, 0x4C, 0x46, 0x41, 0xFF, 0x3F, 0x3E, 0x45,
+  0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x40, 0xFF, 0x49, 0x42, 0x4A, 0x47,
+  0x51, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2A, 0x2B, 0x2C, 0x2D, 0x2E, 0x2F, 0x30, 0x31, 0x32,
+  0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x3B, 0x3C, 0x3D, 0x4D, 0xFF, 0x4E, 0x43, 0xFF,
+  0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18,
+  0x19, 0x1A, 0x1B, 0x1C, 0x1D, 0x1E, 0x1F, 0x20, 0x21, 0x22, 0x23, 0x4F, 0xFF, 0x50, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+#define GROUP_MAX_HIGH (0xFFFFFFFFu / 85)     // the most the first four digits of a group can be worth without overflowing
+
+// one whole group: 4 bytes, big-endian, to 5 digits.  Division by a constant compiles to a multiply.
+static inline void encodeGroup(uint32_t value, char *out) {
+  out[4] = encoder[value % 85];
+  value /= 85;
+  out[3] = encoder[value % 85];
+  value /= 85;
+  out[2] = encoder[value % 85];
+  value /= 85;
+  out[1] = encoder[value % 85];
+  out[0] = encoder[value / 85];
+}
+
+size_t z85Encode(const uint8_t *data, size_t length, char *out) {
+  const uint8_t *end = data + (length & ~(size_t)3);
+  char *at = out;
+
+  for (; data < end; data += 4, at += 5) {
+    encodeGroup((uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | (uint32_t)data[2] << 8 | data[3], at);
+  }
+
+  // a short final group is padded with zeros and only its first group + 1 characters are kept
+  size_t group = length & 3;
+  if (group) {
+    uint32_t value = 0;
+    char chars[5];
+
+    for (size_t j = 0; j < 4; j++) value = value << 8 | (j < group ? data[j] : 0);
+    encodeGroup(value, chars);
+
+    for (size_t j = 0; j < group + 1; j++) *at++ = chars[j];
+  }
+
+  return at - out;
+}
+
+bool z85Decode(const char *text, size_t length, uint8_t *out) {
+  const uint8_t *in = (const uint8_t *)text;
+  const uint8_t *end = in + length / 5 * 5;
+
+  for (; in < end; in += 5, out += 4) {
+    uint8_t d0 = decoder[in[0]], d1 = decoder[in[1]], d2 = decoder[in[2]], d3 = decoder[in[3]], d4 = decoder[in[4]];
+    if ((d0 | d1 | d2 | d3 | d4) & 0x80) return false;
+
+    // 85^4 fits in 32 bits, so only the last step can overflow
+    uint32_t high = ((d0 * 85 + d1) * 85 + d2) * 85 + d3;
+    if (high > GROUP_MAX_HIGH || high * 85 > 0xFFFFFFFFu - d4) return false;
+
+    uint32_t value = high * 85 + d4;
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+  }
+
+  size_t group = length % 5;
+  if (group == 0) return true;
+  if (group == 1) return false;
+
+  // a short final group is padded with the highest digit, which rounds the dropped bytes up and leaves the kept ones exact
+  uint64_t value = 0;
+  for (size_t j = 0; j < 5; j++) {
+    uint8_t digit = j < group ? decoder[in[j]] : 84;
+    if (digit & 0x80) return false;
+
+    value = value * 85 + digit;
+  }
+
+  // the padding never takes a tail the encoder wrote over 32 bits, so one that's over wasn't written by it
+  if (value > 0xFFFFFFFFu) return false;
+
+  for (size_t j = 0; j < group - 1; j++) out[j] = value >> (24 - 8 * j);
+  return true;
+}
@@ -0,0 +1,30 @@
+/*
+ *  Z85 (ZeroMQ RFC 32) text encoding for binary mesh messages.
+ *
+ *  Every 4 bytes become 5 characters from an 85-character set that has no quotes, backslashes or control characters,
+ *  so painlessMesh can carry the result in its JSON envelope without escaping anything.  Unlike plain Z85 the input
+ *  doesn't have to be a multiple of 4 bytes: a final group of 1-3 bytes becomes 2-4 characters (the same trick Ascii85
+ *  uses).
+ *
+ *  Every binary message goes through here, so it's kept cheap: whole groups take one step each, 4 bytes to 5
+ *  characters and back, and the decode table covers every byte value so a group is validated with a single test.  Only
+ *  the short final group takes the slow path.  bench_z85 measures it per byte.
+ */
+
+#ifndef Z85_H
+#define Z85_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define Z85_ENCODED_SIZE(bytes) ((bytes) / 4 * 5 + ((bytes) % 4 ? (bytes) % 4 + 1 : 0))
+#define Z85_DECODED_SIZE(chars) ((chars) / 5 * 4 + ((chars) % 5 ? (chars) % 5 - 1 : 0))
+
+// writes Z85_ENCODED_SIZE(length) characters, no terminator
+size_t z85Encode(const uint8_t *data, size_t length, char *out);
+
+// writes Z85_DECODED_SIZE(length) bytes.  Returns false on a character outside the set, a 1-character tail or a
+// group that overflows 32 bits.
+bool z85Decode(const char *text, size_t length, uint8_t *out);
+
+#endif